@@ -0,0 +1,89 @@
+#pragma once
+
+#include "instrumentation.h"
+#include "kernels.h"
+#include <utility>
+
+namespace fhe {
+
+// Sums terms in place into a ciphertext it owns, so callers' ciphertexts are
+// never modified. Each product is computed straight into a fresh ciphertext
+// that the sum adopts or adds in place, without copying the operand first.
+// Take() hands the sum out and leaves the accumulator ready for the next
+// output, so one accumulator serves a whole kernel call. Works for CKKS, BFV
+// and BGV; the integer schemes take their weights as encoded plaintexts.
+// Shared by the kernel sources.
+class Accumulator {
+public:
+    explicit Accumulator(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc)
+        : cc(cc), rescale(cc->getSchemeId() == lbcrypto::SCHEME::CKKSRNS_SCHEME) {}
+
+    void Add(const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& term) {
+        if (!sum) {
+            sum = term->Clone();
+        } else {
+            FHE_OP_IN_PLACE(EvalAdd, sum, cc->EvalAddInPlace(sum, term));
+        }
+    }
+
+    // For freshly computed terms, which the accumulator may adopt as its sum.
+    void Add(lbcrypto::Ciphertext<lbcrypto::DCRTPoly>&& term) {
+        if (!sum) {
+            sum = std::move(term);
+        } else {
+            FHE_OP_IN_PLACE(EvalAdd, sum, cc->EvalAddInPlace(sum, term));
+        }
+    }
+
+    // sum += a * b. Lazy products stay unrelinearized until Take().
+    void MultiplyAdd(const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& a,
+                     const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& b, Accumulation accumulation) {
+        if (accumulation == Accumulation::Eager) {
+            Add(FHE_OP(EvalMult, cc->EvalMult(a, b)));
+            return;
+        }
+        Add(FHE_OP(EvalMult, cc->EvalMultNoRelin(a, b)));
+        pending = true;
+    }
+
+    // sum += weight * x
+    void MultiplyAdd(const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& x, double weight) {
+        Add(FHE_OP(EvalMult, cc->EvalMult(x, weight)));
+    }
+
+    // sum += weight * x, with the weight replicated over the batch.
+    void MultiplyAdd(const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& x, const lbcrypto::Plaintext& weight) {
+        Add(FHE_OP(EvalMult, cc->EvalMult(x, weight)));
+    }
+
+    void Scale(double factor) { FHE_OP_IN_PLACE(EvalMult, sum, cc->EvalMultInPlace(sum, factor)); }
+    void AddConstant(double constant) { FHE_OP_IN_PLACE(EvalAdd, sum, cc->EvalAddInPlace(sum, constant)); }
+    void AddConstant(const lbcrypto::Plaintext& constant) {
+        FHE_OP_IN_PLACE(EvalAdd, sum, cc->EvalAddInPlace(sum, constant));
+    }
+
+    bool Empty() const { return !sum; }
+
+    // One key switch and one rescale for all lazy products. Under the
+    // automatic scaling techniques OpenFHE defers the rescale to the next
+    // multiplication, which is still once per output. BFV has nothing to
+    // rescale and BGV switches moduli on its own.
+    lbcrypto::Ciphertext<lbcrypto::DCRTPoly> Take() {
+        if (pending) {
+            FHE_OP_IN_PLACE(Relinearize, sum, cc->RelinearizeInPlace(sum));
+            if (rescale) {
+                FHE_OP_IN_PLACE(Rescale, sum, cc->RescaleInPlace(sum));
+            }
+            pending = false;
+        }
+        return std::move(sum);
+    }
+
+private:
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc;
+    lbcrypto::Ciphertext<lbcrypto::DCRTPoly> sum;
+    const bool rescale;
+    bool pending = false;
+};
+
+}  // namespace fhe
@@ -0,0 +1,159 @@
+#include "batch_crypto.h"
+#include "instrumentation.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace lbcrypto;
+using namespace std;
+
+namespace fhe {
+
+BatchEncryptor::BatchEncryptor(const CryptoContext<DCRTPoly>& cc, const PublicKey<DCRTPoly>& publicKey,
+                               ThreadPool& pool)
+    : cc(cc), publicKey(publicKey), pool(pool) {}
+
+vector<Ciphertext<DCRTPoly>> BatchEncryptor::EncryptSlots(const vector<vector<double>>& slots) const {
+    vector<Ciphertext<DCRTPoly>> ciphertexts(slots.size());
+    pool.ParallelFor(slots.size(), [&](size_t i) {
+        Plaintext ptx = FHE_OP(Encode, cc->MakeCKKSPackedPlaintext(slots[i]));
+        ciphertexts[i] = FHE_OP(Encrypt, cc->Encrypt(publicKey, ptx));
+    });
+    return ciphertexts;
+}
+
+EncryptedMatrix BatchEncryptor::Encrypt(const PlainGrid& values, Packing packing) const {
+    return move(EncryptAll({values}, packing)[0]);
+}
+
+CiphertextGrid BatchEncryptor::EncryptGrid(const PlainGrid& values) const {
+    return Encrypt(values, Packing::Element).ToGrid();
+}
+
+vector<EncryptedMatrix> BatchEncryptor::EncryptAll(const vector<PlainGrid>& matrices, Packing packing) const {
+    const uint32_t batchSize = cc->GetEncodingParams()->GetBatchSize();
+    vector<vector<double>> slots;
+    vector<size_t> counts;
+    for (const auto& values : matrices) {
+        vector<vector<double>> packed = pack(values, packing, batchSize);
+        counts.push_back(packed.size());
+        slots.insert(slots.end(), make_move_iterator(packed.begin()), make_move_iterator(packed.end()));
+    }
+    vector<Ciphertext<DCRTPoly>> ciphertexts = EncryptSlots(slots);
+
+    vector<EncryptedMatrix> encrypted;
+    encrypted.reserve(matrices.size());
+    auto next = ciphertexts.begin();
+    for (size_t m = 0; m < matrices.size(); m++) {
+        const uint32_t rows = matrices[m].size();
+        const uint32_t cols = matrices[m].empty() ? 0 : matrices[m][0].size();
+        vector<Ciphertext<DCRTPoly>> own(make_move_iterator(next), make_move_iterator(next + counts[m]));
+        next += counts[m];
+        encrypted.emplace_back(packing, rows, cols, move(own));
+    }
+    return encrypted;
+}
+
+EncryptedMatrix BatchEncryptor::EncryptIntegers(const IntGrid& values, Packing packing) const {
+    checkIntegerRange(cc, values);
+    const vector<vector<int64_t>> slots = pack(values, packing, cc->GetEncodingParams()->GetBatchSize());
+    vector<Ciphertext<DCRTPoly>> ciphertexts(slots.size());
+    pool.ParallelFor(slots.size(), [&](size_t i) {
+        Plaintext ptx = FHE_OP(Encode, cc->MakePackedPlaintext(slots[i]));
+        ciphertexts[i] = FHE_OP(Encrypt, cc->Encrypt(publicKey, ptx));
+    });
+    const uint32_t rows = values.size();
+    const uint32_t cols = values.empty() ? 0 : values[0].size();
+    return EncryptedMatrix(packing, rows, cols, move(ciphertexts));
+}
+
+BatchDecryptor::BatchDecryptor(const CryptoContext<DCRTPoly>& cc, const PrivateKey<DCRTPoly>& secretKey,
+                               ThreadPool& pool)
+    : cc(cc), secretKey(secretKey), pool(pool) {}
+
+void BatchDecryptor::DecryptRanges(const vector<Ciphertext<DCRTPoly>>& ciphertexts, const vector<SlotRange>& ranges,
+                                   double* out) const {
+    // Output offset of every range, and the ranges read from each ciphertext.
+    vector<size_t> offsets(ranges.size());
+    vector<vector<size_t>> wanted(ciphertexts.size());
+    size_t total = 0;
+    size_t batchSize = cc->GetEncodingParams()->GetBatchSize();
+    if (batchSize == 0) {
+        batchSize = cc->GetRingDimension() / 2;
+    }
+    for (size_t r = 0; r < ranges.size(); r++) {
+        if (ranges[r].ciphertext >= ciphertexts.size()) {
+            throw out_of_range("BatchDecryptor: slot range names a missing ciphertext");
+        }
+        if (static_cast<size_t>(ranges[r].offset) + ranges[r].length > batchSize) {
+            throw out_of_range("BatchDecryptor: slot range ends past the batch size of " + to_string(batchSize));
+        }
+        offsets[r] = total;
+        total += ranges[r].length;
+        wanted[ranges[r].ciphertext].push_back(r);
+    }
+    vector<size_t> needed;
+    for (size_t c = 0; c < ciphertexts.size(); c++) {
+        if (!wanted[c].empty()) {
+            needed.push_back(c);
+        }
+    }
+
+    pool.ParallelFor(needed.size(), [&](size_t k) {
+        const size_t c = needed[k];
+        size_t end = 0;
+        for (size_t r : wanted[c]) {
+            end = max<size_t>(end, ranges[r].offset + ranges[r].length);
+        }
+        Plaintext result;
+        FHE_OP(Decrypt, cc->Decrypt(secretKey, ciphertexts[c], &result));
+        result->SetLength(end);
+        const auto& slots = result->GetCKKSPackedValue();
+        for (size_t r : wanted[c]) {
+            double* dst = out + offsets[r];
+            for (uint32_t i = 0; i < ranges[r].length; i++) {
+                dst[i] = slots[ranges[r].offset + i].real();
+            }
+        }
+    });
+}
+
+vector<double> BatchDecryptor::DecryptPrefix(const vector<Ciphertext<DCRTPoly>>& ciphertexts, uint32_t length) const {
+    vector<SlotRange> ranges;
+    ranges.reserve(ciphertexts.size());
+    for (size_t c = 0; c < ciphertexts.size(); c++) {
+        ranges.push_back({c, 0, length});
+    }
+    vector<double> values(ciphertexts.size() * length);
+    DecryptRanges(ciphertexts, ranges, values.data());
+    return values;
+}
+
+PlainGrid BatchDecryptor::Decrypt(const EncryptedMatrix& matrix) const {
+    const uint32_t used = slotsUsed(matrix.GetPacking(), matrix.Rows(), matrix.Cols());
+    vector<double> flat = DecryptPrefix(matrix.Ciphertexts(), used);
+    vector<vector<double>> slots;
+    slots.reserve(matrix.Ciphertexts().size());
+    for (auto it = flat.begin(); it != flat.end(); it += used) {
+        slots.emplace_back(it, it + used);
+    }
+    return unpack(slots, matrix.GetPacking(), matrix.Rows(), matrix.Cols());
+}
+
+PlainGrid BatchDecryptor::DecryptGrid(const CiphertextGrid& grid) const {
+    return Decrypt(EncryptedMatrix::FromGrid(grid));
+}
+
+IntGrid BatchDecryptor::DecryptIntegers(const EncryptedMatrix& matrix) const {
+    const uint32_t used = slotsUsed(matrix.GetPacking(), matrix.Rows(), matrix.Cols());
+    vector<vector<int64_t>> slots(matrix.Ciphertexts().size());
+    pool.ParallelFor(slots.size(), [&](size_t c) {
+        Plaintext result;
+        FHE_OP(Decrypt, cc->Decrypt(secretKey, matrix.At(c), &result));
+        result->SetLength(used);
+        const auto& packed = result->GetPackedValue();
+        slots[c].assign(packed.begin(), packed.begin() + used);
+    });
+    return unpack(slots, matrix.GetPacking(), matrix.Rows(), matrix.Cols());
+}
+
+}  // namespace fhe
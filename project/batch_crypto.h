@@ -0,0 +1,72 @@
+#pragma once
+
+#include "encrypted_matrix.h"
+#include "thread_pool.h"
+#include <cstdint>
+#include <vector>
+
+namespace fhe {
+
+// Client-side bulk encode-and-encrypt. Every ciphertext is an independent
+// task on the pool, so encoding and encryption of different slot vectors run
+// concurrently.
+class BatchEncryptor {
+public:
+    BatchEncryptor(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                   const lbcrypto::PublicKey<lbcrypto::DCRTPoly>& publicKey, ThreadPool& pool);
+
+    // One ciphertext per slot vector, in order.
+    std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> EncryptSlots(
+        const std::vector<std::vector<double>>& slots) const;
+
+    EncryptedMatrix Encrypt(const PlainGrid& values, Packing packing) const;
+    CiphertextGrid EncryptGrid(const PlainGrid& values) const;
+
+    // Many matrices in a single parallel pass, e.g. a batch of images.
+    std::vector<EncryptedMatrix> EncryptAll(const std::vector<PlainGrid>& matrices, Packing packing) const;
+
+    // BFV or BGV counterpart of Encrypt(); see EncryptedMatrix::EncryptIntegers().
+    EncryptedMatrix EncryptIntegers(const IntGrid& values, Packing packing) const;
+
+private:
+    lbcrypto::CryptoContext<lbcrypto::DCRTPoly> cc;
+    lbcrypto::PublicKey<lbcrypto::DCRTPoly> publicKey;
+    ThreadPool& pool;
+};
+
+// Slots [offset, offset + length) of one ciphertext in a batch.
+struct SlotRange {
+    size_t ciphertext;
+    uint32_t offset;
+    uint32_t length;
+};
+
+// Client-side bulk decryption. Each ciphertext is decrypted once, on the pool,
+// and only the requested slots are copied out of the decoded plaintext.
+class BatchDecryptor {
+public:
+    BatchDecryptor(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                   const lbcrypto::PrivateKey<lbcrypto::DCRTPoly>& secretKey, ThreadPool& pool);
+
+    // Writes the ranges back to back into `out`, which must hold the sum of
+    // their lengths. Several ranges may name the same ciphertext.
+    void DecryptRanges(const std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>>& ciphertexts,
+                       const std::vector<SlotRange>& ranges, double* out) const;
+
+    // The first `length` slots of every ciphertext, concatenated.
+    std::vector<double> DecryptPrefix(const std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>>& ciphertexts,
+                                      uint32_t length) const;
+
+    PlainGrid Decrypt(const EncryptedMatrix& matrix) const;
+    PlainGrid DecryptGrid(const CiphertextGrid& grid) const;
+
+    // BFV or BGV counterpart of Decrypt(), exact.
+    IntGrid DecryptIntegers(const EncryptedMatrix& matrix) const;
+
+private:
+    lbcrypto::CryptoContext<lbcrypto::DCRTPoly> cc;
+    lbcrypto::PrivateKey<lbcrypto::DCRTPoly> secretKey;
+    ThreadPool& pool;
+};
+
+}  // namespace fhe
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace fhe {
+
+// Unbounded multi-producer multi-consumer queue. Pop() blocks until an item
+// arrives or the queue is closed and drained.
+template <typename T>
+class BlockingQueue {
+public:
+    void Push(T item) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            items.push_back(std::move(item));
+        }
+        ready.notify_one();
+    }
+
+    std::optional<T> Pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [&] { return !items.empty() || closed; });
+        if (items.empty()) {
+            return std::nullopt;
+        }
+        T item = std::move(items.front());
+        items.pop_front();
+        return item;
+    }
+
+    // Wakes every waiting Pop(); items already queued are still delivered.
+    void Close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        ready.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<T> items;
+    bool closed = false;
+};
+
+}  // namespace fhe
@@ -0,0 +1,113 @@
+#include "openfhe.h"
+#include "pipeline.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+
+using namespace lbcrypto;
+using namespace std;
+
+// Measures the cost of CKKS bootstrapping and of a pipeline that needs it.
+// Usage: bootstrap_benchmark [numLayers] [ringDim]
+// A non-zero ringDim disables the security check so small rings can be timed.
+
+template <typename F>
+double timeMs(F&& f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        uint32_t numLayers = argc > 1 ? stoul(argv[1]) : 16;
+        uint32_t ringDim = argc > 2 ? stoul(argv[2]) : 0;
+        const uint32_t scaleModSize = 50;
+        const uint32_t batchSize = 8;
+        const uint32_t repetitions = 3;
+
+        // A contracting polynomial keeps the values in [-1, 1] across many layers.
+        fhe::Pipeline pipeline;
+        for (uint32_t i = 0; i < numLayers; i++) {
+            pipeline.Add(make_shared<fhe::PolynomialActivationLayer>("poly" + to_string(i),
+                                                                     vector<double>{0.0, 0.5, 0.25}));
+        }
+        fhe::BootstrapConfig config;
+        config.levelsAfterBootstrap = 4;
+        pipeline.EnableBootstrapping(config);
+
+        CCParams<CryptoContextCKKSRNS> parameters = pipeline.Parameters(scaleModSize, batchSize);
+        if (ringDim != 0) {
+            parameters.SetSecurityLevel(HEStd_NotSet);
+            parameters.SetRingDim(ringDim);
+        }
+
+        CryptoContext<DCRTPoly> cc;
+        KeyPair<DCRTPoly> keys;
+        double contextMs = timeMs([&] {
+            cc = GenCryptoContext(parameters);
+            cc->Enable(PKE);
+            cc->Enable(KEYSWITCH);
+            cc->Enable(LEVELEDSHE);
+        });
+        double keygenMs = timeMs([&] {
+            keys = cc->KeyGen();
+            cc->EvalMultKeyGen(keys.secretKey);
+        });
+        double bootstrapKeygenMs = timeMs([&] { pipeline.PrepareBootstrapping(cc, keys.secretKey, batchSize); });
+
+        cout << "Pipeline depth: " << pipeline.Depth() << " | context depth: " << pipeline.MultDepth()
+             << " | ring dimension: " << cc->GetRingDimension() << endl;
+        cout << "Bootstraps planned before layers:";
+        for (size_t index : pipeline.BootstrapPlan()) {
+            cout << " " << index;
+        }
+        cout << endl;
+
+        fhe::PlainGrid X = {{0.1, 0.3}, {0.5, 0.7}};
+        fhe::CiphertextGrid encryptedX = fhe::encryptGrid(cc, keys.publicKey, X);
+
+        // Isolated bootstrap cost on a fresh ciphertext
+        double bootstrapMs = 0.0;
+        Ciphertext<DCRTPoly> refreshed;
+        for (uint32_t r = 0; r < repetitions; r++) {
+            bootstrapMs += timeMs([&] { refreshed = cc->EvalBootstrap(encryptedX[0][0]); });
+        }
+        bootstrapMs /= repetitions;
+        Plaintext result;
+        cc->Decrypt(keys.secretKey, refreshed, &result);
+        result->SetLength(1);
+        double bootstrapError = abs(result->GetCKKSPackedValue()[0].real() - X[0][0]);
+
+        // End-to-end pipeline with automatic bootstrapping
+        vector<fhe::CiphertextGrid> stages;
+        double pipelineMs = timeMs([&] { stages = pipeline.Run(cc, encryptedX); });
+        fhe::PlainGrid decrypted = fhe::decryptGrid(cc, keys.secretKey, stages.back());
+        fhe::PlainGrid expected = pipeline.Reference(X).back();
+        double maxError = 0.0;
+        for (size_t i = 0; i < X.size(); i++) {
+            for (size_t j = 0; j < X[i].size(); j++) {
+                maxError = max(maxError, abs(decrypted[i][j] - expected[i][j]));
+            }
+        }
+
+        size_t ciphertextsPerBootstrap = X.size() * X[0].size();
+        cout << "\nContext generation:        " << contextMs << " ms" << endl;
+        cout << "KeyGen + EvalMultKeyGen:   " << keygenMs << " ms" << endl;
+        cout << "Bootstrap setup + keygen:  " << bootstrapKeygenMs << " ms" << endl;
+        cout << "EvalBootstrap (mean of " << repetitions << "): " << bootstrapMs << " ms | error: " << bootstrapError
+             << endl;
+        cout << "Pipeline run (" << numLayers << " layers, " << pipeline.BootstrapPlan().size() << " x "
+             << ciphertextsPerBootstrap << " bootstraps): " << pipelineMs << " ms | max error: " << maxError << endl;
+
+    } catch (const exception& e) {
+        cerr << "Exception: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
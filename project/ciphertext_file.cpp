@@ -0,0 +1,310 @@
+#include "ciphertext_file.h"
+#include "ciphertext-ser.h"
+#include "scheme/ckksrns/ckksrns-ser.h"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace lbcrypto;
+using namespace std;
+
+namespace fhe {
+
+namespace {
+
+const char magic[] = "FHECT001";
+const char endMagic[] = "FHECTEND";
+const size_t magicSize = 8;
+// Index offset plus the end magic.
+const size_t trailerSize = 8 + magicSize;
+
+void writeU64(ostream& out, uint64_t value) {
+    char bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    out.write(bytes, 8);
+}
+
+void writeU32(ostream& out, uint32_t value) {
+    char bytes[4];
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    out.write(bytes, 4);
+}
+
+uint64_t readU64(istream& in) {
+    unsigned char bytes[8];
+    if (!in.read(reinterpret_cast<char*>(bytes), 8)) {
+        throw runtime_error("CiphertextReader: truncated container");
+    }
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+uint32_t readU32(istream& in) {
+    unsigned char bytes[4];
+    if (!in.read(reinterpret_cast<char*>(bytes), 4)) {
+        throw runtime_error("CiphertextReader: truncated container");
+    }
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+void checkMagic(istream& in, const char* expected) {
+    char bytes[magicSize];
+    if (!in.read(bytes, magicSize) || memcmp(bytes, expected, magicSize) != 0) {
+        throw runtime_error("CiphertextReader: not a ciphertext container");
+    }
+}
+
+// Magic plus seven 32/64-bit fields.
+const size_t headerSize = magicSize + 6 * 4 + 8;
+
+void writeHeader(ostream& out, const CiphertextFileHeader& header) {
+    uint64_t scaleBits;
+    memcpy(&scaleBits, &header.scalingFactor, sizeof(scaleBits));
+    out.write(magic, magicSize);
+    writeU32(out, static_cast<uint32_t>(header.packing));
+    writeU32(out, header.rows);
+    writeU32(out, header.cols);
+    writeU32(out, header.chunkSize);
+    writeU32(out, header.level);
+    writeU32(out, header.noiseScaleDeg);
+    writeU64(out, scaleBits);
+}
+
+CiphertextFileHeader readHeader(istream& in) {
+    checkMagic(in, magic);
+    CiphertextFileHeader header;
+    uint32_t packing = readU32(in);
+    if (packing > static_cast<uint32_t>(Packing::Flat)) {
+        throw runtime_error("CiphertextReader: unknown packing " + to_string(packing));
+    }
+    header.packing = static_cast<Packing>(packing);
+    header.rows = readU32(in);
+    header.cols = readU32(in);
+    header.chunkSize = readU32(in);
+    if (header.chunkSize == 0) {
+        throw runtime_error("CiphertextReader: chunk size must be positive");
+    }
+    header.level = readU32(in);
+    header.noiseScaleDeg = readU32(in);
+    uint64_t scaleBits = readU64(in);
+    memcpy(&header.scalingFactor, &scaleBits, sizeof(scaleBits));
+    return header;
+}
+
+// Reads the ciphertexts of a chunk whose count has already been consumed.
+// The count comes from the file and is checked before anything is allocated.
+vector<Ciphertext<DCRTPoly>> readChunkBody(istream& in, uint32_t ciphertexts, const CiphertextFileHeader& header) {
+    if (ciphertexts > header.chunkSize) {
+        throw runtime_error("CiphertextReader: chunk of " + to_string(ciphertexts) +
+                            " ciphertexts exceeds the chunk size " + to_string(header.chunkSize));
+    }
+    readU64(in);  // byte length, only needed to skip chunks
+    vector<Ciphertext<DCRTPoly>> chunk(ciphertexts);
+    for (auto& ct : chunk) {
+        Serial::Deserialize(ct, in, SerType::BINARY);
+        if (!ct || !in) {
+            throw runtime_error("CiphertextReader: cannot deserialize a ciphertext");
+        }
+    }
+    return chunk;
+}
+
+}  // namespace
+
+CiphertextWriter::CiphertextWriter(ostream& out, Packing packing, uint32_t rows, uint32_t cols, uint32_t chunkSize)
+    : out(out) {
+    if (chunkSize == 0) {
+        throw invalid_argument("CiphertextWriter: chunk size must be positive");
+    }
+    header.packing = packing;
+    header.rows = rows;
+    header.cols = cols;
+    header.chunkSize = chunkSize;
+}
+
+void CiphertextWriter::WriteHeader() {
+    writeHeader(out, header);
+    position += headerSize;
+    headerWritten = true;
+}
+
+void CiphertextWriter::Append(const Ciphertext<DCRTPoly>& ciphertext) {
+    if (finished) {
+        throw logic_error("CiphertextWriter: Append() after Finish()");
+    }
+    if (!headerWritten) {
+        header.level = ciphertext->GetLevel();
+        header.noiseScaleDeg = ciphertext->GetNoiseScaleDeg();
+        header.scalingFactor = ciphertext->GetScalingFactor();
+        WriteHeader();
+    }
+    pending.push_back(ciphertext);
+    if (pending.size() == header.chunkSize) {
+        FlushChunk();
+    }
+}
+
+void CiphertextWriter::FlushChunk() {
+    // Serialized up front so the chunk can carry its byte length.
+    ostringstream body;
+    for (const auto& ct : pending) {
+        Serial::Serialize(ct, body, SerType::BINARY);
+    }
+    const string bytes = body.str();
+    chunkOffsets.push_back(position);
+    writeU32(out, pending.size());
+    writeU64(out, bytes.size());
+    out.write(bytes.data(), bytes.size());
+    if (!out) {
+        throw runtime_error("CiphertextWriter: write failed");
+    }
+    position += 4 + 8 + bytes.size();
+    count += pending.size();
+    pending.clear();
+}
+
+void CiphertextWriter::Finish() {
+    if (finished) {
+        return;
+    }
+    if (!headerWritten) {
+        WriteHeader();
+    }
+    if (!pending.empty()) {
+        FlushChunk();
+    }
+    writeU32(out, 0);
+    position += 4;
+
+    const uint64_t indexOffset = position;
+    writeU64(out, chunkOffsets.size());
+    for (uint64_t offset : chunkOffsets) {
+        writeU64(out, offset);
+    }
+    writeU64(out, count);
+    writeU64(out, indexOffset);
+    out.write(endMagic, magicSize);
+    out.flush();
+    if (!out) {
+        throw runtime_error("CiphertextWriter: write failed");
+    }
+    finished = true;
+}
+
+CiphertextReader::CiphertextReader(const string& path) : file(make_unique<MappedFile>(path)) {
+    if (file->Size() < headerSize + 4 + trailerSize) {
+        throw runtime_error("CiphertextReader: " + path + " is too small to be a ciphertext container");
+    }
+    MemoryBuffer headerBuffer(file->Data(), headerSize);
+    istream headerIn(&headerBuffer);
+    header = readHeader(headerIn);
+
+    MemoryBuffer trailerBuffer(file->Data() + file->Size() - trailerSize, trailerSize);
+    istream trailerIn(&trailerBuffer);
+    uint64_t indexOffset = readU64(trailerIn);
+    checkMagic(trailerIn, endMagic);
+    if (indexOffset >= file->Size() - trailerSize) {
+        throw runtime_error("CiphertextReader: corrupt index offset in " + path);
+    }
+
+    MemoryBuffer indexBuffer(file->Data() + indexOffset, file->Size() - trailerSize - indexOffset);
+    istream indexIn(&indexBuffer);
+    // Chunk count, offsets and ciphertext count, 8 bytes each.
+    const uint64_t indexSize = file->Size() - trailerSize - indexOffset;
+    const uint64_t chunks = readU64(indexIn);
+    if (indexSize < 16 || chunks > (indexSize - 16) / 8) {
+        throw runtime_error("CiphertextReader: corrupt chunk count in " + path);
+    }
+    chunkOffsets.resize(chunks);
+    for (auto& offset : chunkOffsets) {
+        offset = readU64(indexIn);
+        if (offset >= indexOffset) {
+            throw runtime_error("CiphertextReader: corrupt chunk offset in " + path);
+        }
+    }
+    count = readU64(indexIn);
+    if (count > chunks * header.chunkSize) {
+        throw runtime_error("CiphertextReader: corrupt ciphertext count in " + path);
+    }
+}
+
+vector<Ciphertext<DCRTPoly>> CiphertextReader::ReadChunk(size_t chunk) const {
+    if (chunk >= chunkOffsets.size()) {
+        throw out_of_range("CiphertextReader: chunk " + to_string(chunk) + " of " + to_string(chunkOffsets.size()));
+    }
+    const uint64_t offset = chunkOffsets[chunk];
+    MemoryBuffer buffer(file->Data() + offset, file->Size() - offset);
+    istream in(&buffer);
+    return readChunkBody(in, readU32(in), header);
+}
+
+Ciphertext<DCRTPoly> CiphertextReader::Read(size_t index) const {
+    if (index >= count) {
+        throw out_of_range("CiphertextReader: ciphertext " + to_string(index) + " of " + to_string(count));
+    }
+    vector<Ciphertext<DCRTPoly>> chunk = ReadChunk(index / header.chunkSize);
+    if (index % header.chunkSize >= chunk.size()) {
+        throw runtime_error("CiphertextReader: ciphertext " + to_string(index) + " missing from its chunk");
+    }
+    return chunk[index % header.chunkSize];
+}
+
+EncryptedMatrix CiphertextReader::ReadMatrix() const {
+    vector<Ciphertext<DCRTPoly>> ciphertexts;
+    ciphertexts.reserve(count);
+    for (size_t chunk = 0; chunk < chunkOffsets.size(); chunk++) {
+        for (auto& ct : ReadChunk(chunk)) {
+            ciphertexts.push_back(move(ct));
+        }
+    }
+    return EncryptedMatrix(header.packing, header.rows, header.cols, move(ciphertexts));
+}
+
+CiphertextStreamReader::CiphertextStreamReader(istream& in) : in(in), header(readHeader(in)) {}
+
+bool CiphertextStreamReader::Next(vector<Ciphertext<DCRTPoly>>& ciphertexts) {
+    uint32_t size = readU32(in);
+    if (size == 0) {
+        // Consume the index and trailer so another container can follow.
+        uint64_t chunks = readU64(in);
+        for (uint64_t i = 0; i < chunks; i++) {
+            readU64(in);
+        }
+        readU64(in);  // ciphertext count
+        readU64(in);  // index offset
+        checkMagic(in, endMagic);
+        return false;
+    }
+    ciphertexts = readChunkBody(in, size, header);
+    return true;
+}
+
+void saveMatrix(const string& path, const EncryptedMatrix& matrix, uint32_t chunkSize) {
+    ofstream out(path, ios::binary);
+    if (!out) {
+        throw runtime_error("saveMatrix: cannot open " + path);
+    }
+    CiphertextWriter writer(out, matrix.GetPacking(), matrix.Rows(), matrix.Cols(), chunkSize);
+    for (const auto& ct : matrix.Ciphertexts()) {
+        writer.Append(ct);
+    }
+    writer.Finish();
+}
+
+EncryptedMatrix loadMatrix(const string& path) {
+    return CiphertextReader(path).ReadMatrix();
+}
+
+}  // namespace fhe
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "encrypted_matrix.h"
+#include "mapped_file.h"
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace fhe {
+
+// Layout, level and scale of a stored matrix, taken from its first
+// ciphertext.
+struct CiphertextFileHeader {
+    Packing packing = Packing::Element;
+    uint32_t rows = 0;
+    uint32_t cols = 0;
+    // Ciphertexts per chunk, the unit of reading and writing.
+    uint32_t chunkSize = 0;
+    uint32_t level = 0;
+    uint32_t noiseScaleDeg = 1;
+    double scalingFactor = 0.0;
+};
+
+// Container format, all integers little-endian:
+//   magic "FHECT001" | header | chunk* | end marker | chunk index | trailer
+// A chunk is a ciphertext count, a byte length and the ciphertexts in
+// OpenFHE's binary format. The end marker is a zero count. The index holds
+// the offset of every chunk, and the trailer holds the offset of the index
+// followed by "FHECTEND". Writing is append-only, so it works on pipes and
+// sockets. Files can be read one chunk at a time.
+class CiphertextWriter {
+public:
+    CiphertextWriter(std::ostream& out, Packing packing, uint32_t rows, uint32_t cols, uint32_t chunkSize = 16);
+
+    // Buffers `ciphertext` and writes a chunk once chunkSize are pending. The
+    // header goes out with the first ciphertext.
+    void Append(const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& ciphertext);
+
+    // Writes the last partial chunk, the end marker and the index.
+    void Finish();
+
+private:
+    void WriteHeader();
+    void FlushChunk();
+
+    std::ostream& out;
+    CiphertextFileHeader header;
+    std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> pending;
+    std::vector<uint64_t> chunkOffsets;
+    uint64_t position = 0;
+    uint64_t count = 0;
+    bool headerWritten = false;
+    bool finished = false;
+};
+
+// Random access to a container file through a memory map. Only the header
+// and index are parsed up front; chunks are deserialized on request. The
+// CryptoContext the ciphertexts belong to must already be loaded.
+class CiphertextReader {
+public:
+    explicit CiphertextReader(const std::string& path);
+
+    const CiphertextFileHeader& Header() const { return header; }
+    size_t Size() const { return count; }
+    size_t Chunks() const { return chunkOffsets.size(); }
+
+    std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> ReadChunk(size_t chunk) const;
+    lbcrypto::Ciphertext<lbcrypto::DCRTPoly> Read(size_t index) const;
+    EncryptedMatrix ReadMatrix() const;
+
+private:
+    std::unique_ptr<MappedFile> file;
+    CiphertextFileHeader header;
+    std::vector<uint64_t> chunkOffsets;
+    uint64_t count = 0;
+};
+
+// Sequential reader for a container arriving on a stream. Reads through the
+// trailer, so containers can follow each other on one stream.
+class CiphertextStreamReader {
+public:
+    explicit CiphertextStreamReader(std::istream& in);
+
+    const CiphertextFileHeader& Header() const { return header; }
+
+    // Reads the next chunk into `ciphertexts`; false once the container ends.
+    bool Next(std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>>& ciphertexts);
+
+private:
+    std::istream& in;
+    CiphertextFileHeader header;
+};
+
+void saveMatrix(const std::string& path, const EncryptedMatrix& matrix, uint32_t chunkSize = 16);
+EncryptedMatrix loadMatrix(const std::string& path);
+
+}  // namespace fhe
@@ -1,14 +1,19 @@
 #include "openfhe.h"
+#include "expression_graph.h"
+#include "pipeline.h"
 #include <iostream>
 #include <vector>
 #include <cmath>
 #include <algorithm>
 #include <iomanip>
+#include <memory>
 
 using namespace lbcrypto;
 using namespace std;
 
 const double acceptable_error = 1e-3;
+// Degree-4 Chebyshev fit of the real SiLU over the tracked input range
+const double acceptable_approximation_error = 1e-2;
 
 // Plaintext functions
 double square_func(double x) {
@@ -19,17 +24,77 @@ double poly_silu_approx(double x) {
     return 0.5 * x + 0.25 * x * x - (1.0/48.0) * pow(x, 4);
 }
 
+double silu(double x) {
+    return x / (1.0 + exp(-x));
+}
+
 int main() {
     try {
+        vector<vector<double>> X = {{1.0, 2.0, 3.0}, {4.0, 5.0, 6.0}, {7.0, 8.0, 9.0}};
+        vector<vector<double>> K = {{1.0, 0.0}, {0.0, 1.0}};
+
+        // Square and polynomial SiLU of the convolution, written out naively:
+        // each activation convolves on its own, zero kernel taps included, and
+        // x^4 is a chain of products. Optimize() shares the convolution and
+        // x^2, drops the zero taps and the unit weights, and balances x^4.
+        const vector<double> siluCoefficients = {0.0, 0.5, 0.25, 0.0, -1.0 / 48.0};
+        fhe::ExpressionGraph graph;
+        vector<fhe::ExpressionGraph::Node> pixels;
+        for (size_t i = 0; i < X.size() * X[0].size(); i++) {
+            pixels.push_back(graph.Input());
+        }
+        auto convolve = [&](size_t i, size_t j) {
+            vector<fhe::ExpressionGraph::Node> taps;
+            for (size_t m = 0; m < K.size(); m++) {
+                for (size_t n = 0; n < K[0].size(); n++) {
+                    taps.push_back(graph.Mult(pixels[(i + m) * X[0].size() + j + n], graph.Constant(K[m][n])));
+                }
+            }
+            return graph.Sum(taps);
+        };
+        // Outputs: the four squares, then the four SiLU values.
+        for (size_t i = 0; i < 2; i++) {
+            for (size_t j = 0; j < 2; j++) {
+                graph.Output(graph.Mult(convolve(i, j), convolve(i, j)));
+            }
+        }
+        for (size_t i = 0; i < 2; i++) {
+            for (size_t j = 0; j < 2; j++) {
+                graph.Output(graph.Polynomial(convolve(i, j), siluCoefficients));
+            }
+        }
+        fhe::GraphStats graphStats = graph.Optimize();
+
+        // Range-normalized variant: the pixel range [1, 9] is tracked through
+        // the convolution, the map onto [-1, 1] is folded into the kernel and
+        // the SiLU polynomial is fitted to the real SiLU over that range.
+        auto normalizedConvolution = make_shared<fhe::Conv2DLayer>(K);
+        auto fittedSilu = make_shared<fhe::PolynomialActivationLayer>("silu", silu, 4);
+        fhe::Pipeline normalizedPipeline;
+        normalizedPipeline.Add(normalizedConvolution).Add(fittedSilu);
+        const fhe::Range pixelRange = {1.0, 9.0};
+        vector<fhe::Range> ranges = normalizedPipeline.FoldNormalization(pixelRange);
+
+        // The raw SiLU polynomial is about -744 at x = 14 and -2097 at the
+        // bound x = 18 of the convolution range; the parameters must leave room
+        // for it at the last level.
+        const fhe::Range convRange = fhe::Conv2DLayer(K).OutputRange(pixelRange);
+        ranges.push_back(convRange);
+        ranges.push_back(fhe::PolynomialActivationLayer("square", {0.0, 0.0, 1.0}).OutputRange(convRange));
+        ranges.push_back(fhe::PolynomialActivationLayer("silu", siluCoefficients).OutputRange(convRange));
+        double maxMagnitude = 1.0;
+        for (const fhe::Range& range : ranges) {
+            maxMagnitude = max({maxMagnitude, abs(range.lo), abs(range.hi)});
+        }
+
         // setup cryptocontext and keys and features
-        uint32_t multDepth = 6; 
+        // The depth budget covers the optimized graph and the normalized pipeline.
+        uint32_t multDepth = max(graph.Depth(), normalizedPipeline.Depth());
         uint32_t scaleModSize = 50;
         uint32_t batchSize = 1;
 
-        CCParams<CryptoContextCKKSRNS> parameters;
-        parameters.SetMultiplicativeDepth(multDepth);
-        parameters.SetScalingModSize(scaleModSize);
-        parameters.SetBatchSize(batchSize);
+        CCParams<CryptoContextCKKSRNS> parameters =
+            fhe::makeParameters(multDepth, scaleModSize, batchSize, maxMagnitude);
 
         CryptoContext<DCRTPoly> cc = GenCryptoContext(parameters);
         cc->Enable(PKE);
@@ -40,53 +105,28 @@ int main() {
         KeyPair keys = cc->KeyGen();
         cc->EvalMultKeyGen(keys.secretKey);
 
-        // We reuse logic from Part A to get the inputs for Part B
-        vector<vector<double>> X = {{1.0, 2.0, 3.0}, {4.0, 5.0, 6.0}, {7.0, 8.0, 9.0}};
-        vector<vector<double>> K = {{1.0, 0.0}, {0.0, 1.0}};
-        
-        vector<vector<Ciphertext<DCRTPoly>>> encryptedX(3, vector<Ciphertext<DCRTPoly>>(3));
-        for (int i = 0; i < 3; i++) {
-            for (int j = 0; j < 3; j++) {
-                vector<double> val = {X[i][j]};
-                encryptedX[i][j] = cc->Encrypt(keys.publicKey, cc->MakeCKKSPackedPlaintext(val, scaleModSize, 0));
-            }
-        }
+        fhe::CiphertextGrid encryptedX = fhe::encryptGrid(cc, keys.publicKey, X);
+        // Independent graph operations run concurrently on the pool.
+        fhe::ThreadPool pool;
+        vector<Ciphertext<DCRTPoly>> graphOutputs =
+            graph.Evaluate(cc, fhe::EncryptedMatrix::FromGrid(encryptedX).Ciphertexts(), &pool);
 
-        vector<vector<Ciphertext<DCRTPoly>>> convolutionOutput(2, vector<Ciphertext<DCRTPoly>>(2));
-        for (int i = 0; i < 2; i++) {
-            for (int j = 0; j < 2; j++) {
-                Ciphertext<DCRTPoly> sum;
-                bool first = true;
-                for (int m = 0; m < 2; m++) {
-                    for (int n = 0; n < 2; n++) {
-                         Ciphertext<DCRTPoly> prod = cc->EvalMult(encryptedX[i+m][j+n], K[m][n]);
-                         if (first) { sum = prod; first = false; }
-                         else { sum = cc->EvalAdd(sum, prod); }
-                    }
-                }
-                convolutionOutput[i][j] = sum;
-            }
-        }
-        
         // Expected convolution result (for verification)
-        vector<vector<double>> expectedConv = {{6.0, 8.0}, {12.0, 14.0}};
+        vector<vector<double>> expectedConv = fhe::Conv2DLayer(K).Reference(X);
 
-        // Apply both functions to each element of convolutionOutput
-        
         bool success = true;
 
+        cout << "Multiplicative depth: " << multDepth << " | context depth: " << parameters.GetMultiplicativeDepth()
+             << " for results up to " << maxMagnitude << endl;
+        cout << "Expression graph: " << graphStats.operationsBefore << " -> " << graphStats.operationsAfter
+             << " operations, depth " << graphStats.depthBefore << " -> " << graphStats.depthAfter << endl;
+        // Row 0 holds the squares, row 1 the SiLU values.
+        fhe::PlainGrid graphResult =
+            fhe::EncryptedMatrix(fhe::Packing::Element, 2, 4, move(graphOutputs)).Decrypt(cc, keys.secretKey);
         cout << "\nChecking Square Function f1(x) = x^2:" << endl;
         for(int i=0; i<2; i++){
             for(int j=0; j<2; j++){
-                 // Homomorphic Square
-                 Ciphertext<DCRTPoly> x = convolutionOutput[i][j];
-                 Ciphertext<DCRTPoly> x2 = cc->EvalMult(x, x);
-                 
-                 // Decrypt
-                 Plaintext result;
-                 cc->Decrypt(keys.secretKey, x2, &result);
-                 result->SetLength(1);
-                 double val = result->GetCKKSPackedValue()[0].real();
+                 double val = graphResult[0][i * 2 + j];
                  double expected = square_func(expectedConv[i][j]);
                  
                  cout << "Input: " << expectedConv[i][j] << " | x^2 Result: " << val << " | Expected: " << expected;
@@ -103,26 +143,7 @@ int main() {
         cout << "\nChecking Polynomial SiLU f2(x) = 0.5x + 0.25x^2 - (1/48)x^4:" << endl;
         for(int i=0; i<2; i++){
             for(int j=0; j<2; j++){
-                 Ciphertext<DCRTPoly> x = convolutionOutput[i][j];
-                 
-                 // Compute powers
-                 Ciphertext<DCRTPoly> x2 = cc->EvalMult(x, x);
-                 Ciphertext<DCRTPoly> x4 = cc->EvalMult(x2, x2);
-
-                 // Compute terms
-                 Ciphertext<DCRTPoly> term1 = cc->EvalMult(x, 0.5);
-                 Ciphertext<DCRTPoly> term2 = cc->EvalMult(x2, 0.25);
-                 Ciphertext<DCRTPoly> term3 = cc->EvalMult(x4, -1.0/48.0);
-                 
-                 // Sum
-                 Ciphertext<DCRTPoly> res = cc->EvalAdd(term1, term2);
-                 res = cc->EvalAdd(res, term3);
-
-                 // Decrypt
-                 Plaintext result;
-                 cc->Decrypt(keys.secretKey, res, &result);
-                 result->SetLength(1);
-                 double val = result->GetCKKSPackedValue()[0].real();
+                 double val = graphResult[1][i * 2 + j];
                  double expected = poly_silu_approx(expectedConv[i][j]);
 
                  cout << "Input: " << expectedConv[i][j] << " | SiLU Result: " << val << " | Expected: " << expected;
@@ -136,6 +157,27 @@ int main() {
             }
         }
 
+        cout << "\nChecking range-normalized SiLU against the real SiLU x / (1 + e^-x):" << endl;
+        const fhe::Range& domain = fittedSilu->Domain();
+        cout << "Tracked convolution range: [" << domain.lo << ", " << domain.hi << "]" << endl;
+        vector<fhe::CiphertextGrid> normalizedStages = normalizedPipeline.Run(cc, encryptedX);
+        fhe::PlainGrid normalizedResult = fhe::decryptGrid(cc, keys.secretKey, normalizedStages[1]);
+        for(int i=0; i<2; i++){
+            for(int j=0; j<2; j++){
+                 double val = normalizedResult[i][j];
+                 double expected = silu(expectedConv[i][j]);
+
+                 cout << "Input: " << expectedConv[i][j] << " | SiLU Result: " << val << " | Expected: " << expected;
+                 if (abs(val - expected) > acceptable_approximation_error) {
+                     cout << " [FAIL]";
+                     success = false;
+                 } else {
+                     cout << " [PASS]";
+                 }
+                 cout << endl;
+            }
+        }
+
         if (success) {
             cout << "\nEncrypted Non-Linear Functions Completed successfully." << endl;
             cout << "Whoopee! Bad guys won't be able to steal my precious numbers 😊" << endl;
@@ -1,4 +1,8 @@
 #include "openfhe.h"
+#include "pipeline.h"
+#include "batch_crypto.h"
+#include "kernels.h"
+#include "fixed_kernels.h"
 #include <iostream>
 #include <vector>
 #include <cmath>
@@ -12,23 +16,6 @@ const double acceptable_error = 1e-4;
 
 int main() {
     try {
-        // setup cryptocontext and keys and features
-        uint32_t multDepth = 2;
-        uint32_t scaleModSize = 50;
-        uint32_t batchSize = 1;
-
-        CCParams<CryptoContextCKKSRNS> parameters;
-        parameters.SetMultiplicativeDepth(multDepth);
-        parameters.SetScalingModSize(scaleModSize);
-        parameters.SetBatchSize(batchSize);
-
-        CryptoContext<DCRTPoly> cc = GenCryptoContext(parameters);
-        cc->Enable(PKE);
-        cc->Enable(KEYSWITCH);
-        cc->Enable(LEVELEDSHE);
-
-        KeyPair keys = cc->KeyGen();
-        cc->EvalMultKeyGen(keys.secretKey);
         // Inputs
         // Matrix X
         vector<vector<double>> X = {
@@ -49,44 +36,29 @@ int main() {
             {12.0, 14.0}
         };
 
-        // Encrypt X
-        vector<vector<Ciphertext<DCRTPoly>>> encryptedX(3, vector<Ciphertext<DCRTPoly>>(3));
-        for (int i = 0; i < 3; i++) {
-            for (int j = 0; j < 3; j++) {
-                vector<double> val = {X[i][j]};
-                Plaintext ptx = cc->MakeCKKSPackedPlaintext(val, scaleModSize, 0);
-                encryptedX[i][j] = cc->Encrypt(keys.publicKey, ptx);
-            }
-        }
+        // setup cryptocontext and keys and features, sized for the convolution's depth
+        fhe::Conv2DLayer convolution(K);
+        uint32_t scaleModSize = 50;
+        uint32_t batchSize = 1;
 
-        // Computation of the convolution
-        vector<vector<Ciphertext<DCRTPoly>>> encryptedY(2, vector<Ciphertext<DCRTPoly>>(2));
+        CCParams<CryptoContextCKKSRNS> parameters = fhe::makeParameters(convolution.Depth(), scaleModSize, batchSize);
 
-        for (int i = 0; i < 2; i++) {
-            for (int j = 0; j < 2; j++) {
-                Ciphertext<DCRTPoly> sum;
-                bool first = true;
-
-                for (int m = 0; m < 2; m++) {
-                    for (int n = 0; n < 2; n++) {
-                         // Element-wise multiplication
-                         double kVal = K[m][n];
-                         Ciphertext<DCRTPoly> prod;
-
-                         prod = cc->EvalMult(encryptedX[i+m][j+n], kVal);
-
-                         // Summation of the products
-                         if (first) {
-                             sum = prod;
-                             first = false;
-                         } else {
-                             sum = cc->EvalAdd(sum, prod);
-                         }
-                    }
-                }
-                encryptedY[i][j] = sum;
-            }
-        }
+        CryptoContext<DCRTPoly> cc = GenCryptoContext(parameters);
+        cc->Enable(PKE);
+        cc->Enable(KEYSWITCH);
+        cc->Enable(LEVELEDSHE);
+
+        KeyPair keys = cc->KeyGen();
+        cc->EvalMultKeyGen(keys.secretKey);
+
+        // Encrypt X, one pixel per ciphertext, in parallel
+        fhe::ThreadPool pool;
+        fhe::CiphertextGrid encryptedX = fhe::BatchEncryptor(cc, keys.publicKey, pool).EncryptGrid(X);
+
+        // Computation of the convolution, output rows in parallel. The kernel is
+        // 2x2 at compile time, so its taps are unrolled and the zero taps skipped.
+        fhe::FixedConv2D<2> fixedConvolution({{{K[0][0], K[0][1]}, {K[1][0], K[1][1]}}}, convolution.Bias());
+        fhe::CiphertextGrid encryptedY = fixedConvolution.Apply(cc, encryptedX, &pool);
 
         // Verifying the results
         cout << "\nVerifaction of the results" << endl;
@@ -98,15 +70,12 @@ int main() {
         }
 
         cout << "\nDecrypted Result:" << endl;
+        fhe::PlainGrid decryptedY = fhe::BatchDecryptor(cc, keys.secretKey, pool).DecryptGrid(encryptedY);
         bool success = true;
         for (int i = 0; i < 2; i++) {
             cout << "[ ";
             for (int j = 0; j < 2; j++) {
-                Plaintext result;
-                cc->Decrypt(keys.secretKey, encryptedY[i][j], &result);
-                result->SetLength(1);
-                double val = result->GetCKKSPackedValue()[0].real();
-                
+                double val = decryptedY[i][j];
                 cout << val << " ";
 
                 if (abs(val - expectedY[i][j]) > acceptable_error) {
@@ -0,0 +1,76 @@
+#include "openfhe.h"
+#include "pipeline.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+using namespace lbcrypto;
+using namespace std;
+
+const double acceptable_error = 1e-4;
+
+int main() {
+    try {
+        // Plaintext weights W (2x3) and bias b, encrypted input x
+        vector<vector<double>> W = {
+            {1.0, 2.0, 3.0},
+            {4.0, 5.0, 6.0}
+        };
+        vector<double> b = {0.5, -1.0};
+        vector<double> x = {1.0, 1.0, 2.0};
+
+        // Expected Result y = W x + b
+        vector<double> expectedY = {9.5, 20.0};
+
+        fhe::DenseLayer dense(W, b);
+
+        // setup cryptocontext and keys and features
+        uint32_t scaleModSize = 50;
+        uint32_t batchSize = 4;
+
+        CCParams<CryptoContextCKKSRNS> parameters = fhe::makeParameters(dense.Depth(), scaleModSize, batchSize);
+
+        CryptoContext<DCRTPoly> cc = GenCryptoContext(parameters);
+        cc->Enable(PKE);
+        cc->Enable(KEYSWITCH);
+        cc->Enable(LEVELEDSHE);
+
+        KeyPair keys = cc->KeyGen();
+        cc->EvalMultKeyGen(keys.secretKey);
+        // Only the rotations for the non-zero diagonals of W
+        cc->EvalRotateKeyGen(keys.secretKey, dense.RotationIndices(batchSize, {1, 1}));
+
+        // Encrypt x packed into a single ciphertext
+        Plaintext ptx = cc->MakeCKKSPackedPlaintext(x);
+        fhe::CiphertextGrid encryptedX = {{cc->Encrypt(keys.publicKey, ptx)}};
+
+        // Dense layer: diagonal matrix-vector product plus plaintext bias
+        fhe::CiphertextGrid encryptedY = dense.Forward(cc, encryptedX);
+
+        cout << "\nDecrypted Result y = W x + b (Expected result: [9.5, 20]):" << endl;
+        vector<double> y = fhe::decryptPacked(cc, keys.secretKey, encryptedY[0][0], expectedY.size());
+        bool success = true;
+        for (size_t j = 0; j < y.size(); j++) {
+            double diff = abs(y[j] - expectedY[j]);
+            cout << "   y[" << j << "] (Result): " << y[j] << " | expected: " << expectedY[j] << " | Error: " << diff << endl;
+            if (diff > acceptable_error) {
+                success = false;
+            }
+        }
+
+        if (success) {
+            cout << "\nEncrypted Dense Layer Completed successfully." << endl;
+            cout << "Whoopee! Bad guys won't be able to steal my precious numbers 😊" << endl;
+        } else {
+            cout << "\nEncrypted Dense Layer failing to get expected result. This can be due to unsufficient accuracy or wrong calculations" << endl;
+            cout << "🥺😢" << endl;
+        }
+
+    } catch (const exception& e) {
+        cerr << "Exception: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
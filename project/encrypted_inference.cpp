@@ -0,0 +1,228 @@
+#include "openfhe.h"
+#include "model.h"
+#include "pipeline.h"
+#include "batch_crypto.h"
+#include "instrumentation.h"
+#include "keystore.h"
+#include "precision.h"
+#include "rotation_key_cache.h"
+#include "tuning.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <random>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+using namespace lbcrypto;
+using namespace std;
+namespace fs = std::filesystem;
+
+// End-to-end encrypted inference of a small CNN under a single CKKS context.
+// Usage: encrypted_inference [model file] [number of images] [key store directory] [rotation key budget MB]
+// With a key store, the context and keys are generated once and loaded on
+// later runs (not for bootstrapped models, whose keys are not stored).
+// With a rotation key budget, the rotation keys are written to disk and each
+// layer's keys are loaded on demand, keeping at most that many MB resident
+// (not for bootstrapped models; the key store is then not used). The small
+// CNN needs no rotation keys; models/small_mlp.txt has two packed dense layers
+// with disjoint key sets, so a budget below their total makes them evict.
+
+const double acceptable_error = 1e-2;
+
+double elapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        string modelPath = argc > 1 ? argv[1] : "models/small_cnn.txt";
+        uint32_t numImages = argc > 2 ? stoul(argv[2]) : 4;
+        string keyStorePath = argc > 3 ? argv[3] : "";
+        double rotationBudgetMb = argc > 4 ? stod(argv[4]) : 0.0;
+
+        fhe::Model model = fhe::loadModel(modelPath);
+        const fhe::Pipeline& pipeline = model.pipeline;
+
+        // setup cryptocontext and keys and features, sized for the whole network
+        uint32_t scaleModSize = 50;
+        uint32_t batchSize = model.BatchSize();
+
+        // Spreads keygen, then the encryptions and decryptions, over the cores.
+        fhe::ThreadPool pool;
+        auto setupStart = chrono::steady_clock::now();
+        CCParams<CryptoContextCKKSRNS> parameters = pipeline.Parameters(scaleModSize, batchSize);
+        if (!pipeline.BootstrappingEnabled()) {
+            // Smallest parameters that keep the logits well inside acceptable_error.
+            fhe::ParameterChoice choice = fhe::chooseParameters(fhe::planPipeline(
+                pipeline, model.InputShape(), model.inputRange, batchSize, -log2(acceptable_error) + 10));
+            choice.Report(cout);
+            parameters = choice.Parameters();
+        }
+        vector<int32_t> rotations = pipeline.RotationIndices(batchSize, model.InputShape());
+        const bool onDemandKeys = rotationBudgetMb > 0.0;
+        if (onDemandKeys && pipeline.BootstrappingEnabled()) {
+            throw invalid_argument("a rotation key budget cannot be used with a bootstrapped model");
+        }
+        CryptoContext<DCRTPoly> cc;
+        KeyPair<DCRTPoly> keys;
+        bool keysLoaded = false;
+        unique_ptr<fhe::RotationKeyCache> rotationKeys;
+        const fs::path rotationKeyDir = fs::temp_directory_path() / ("fhe_rotation_keys_" + to_string(getpid()));
+        if (!keyStorePath.empty() && !pipeline.BootstrappingEnabled() && !onDemandKeys) {
+            fhe::KeyMaterial material = fhe::KeyStore(keyStorePath).Open(parameters, {rotations, false});
+            cc = material.cc;
+            keys = material.keys;
+            keysLoaded = material.loaded;
+        } else {
+            cc = GenCryptoContext(parameters);
+            cc->Enable(PKE);
+            cc->Enable(KEYSWITCH);
+            cc->Enable(LEVELEDSHE);
+
+            keys = cc->KeyGen();
+            if (onDemandKeys) {
+                cc->EvalMultKeyGen(keys.secretKey);
+                rotationKeys = make_unique<fhe::RotationKeyCache>(cc, keys.secretKey->GetKeyTag(),
+                                                                  rotationKeyDir.string(),
+                                                                  static_cast<size_t>(rotationBudgetMb * 1024 * 1024));
+                rotationKeys->Generate(keys.secretKey, rotations, &pool);
+                if (rotations.empty()) {
+                    cout << "The model needs no rotation keys; the rotation key budget has no effect" << endl;
+                } else {
+                    cout << "Rotation keys: " << rotations.size() << " keys, "
+                         << rotationKeys->StoredBytes() / (1024.0 * 1024.0) << " MB on disk, budget "
+                         << rotationBudgetMb << " MB" << endl;
+                }
+            } else {
+                fhe::generateEvalKeys(cc, keys.secretKey, {rotations, false}, &pool);
+            }
+            pipeline.PrepareBootstrapping(cc, keys.secretKey, batchSize);
+        }
+        double setupMs = elapsedMs(setupStart);
+
+        cout << "Model: " << modelPath << " (" << pipeline.Layers().size() << " layers, depth " << pipeline.Depth()
+             << ")" << endl;
+        cout << "Ring dimension: " << cc->GetRingDimension() << " | multiplicative depth: " << pipeline.MultDepth()
+             << " | batch size: " << batchSize << endl;
+        cout << (keysLoaded ? "Context and keys loaded from " + keyStorePath : string("Context and key generation"))
+             << ": " << setupMs << " ms" << endl;
+
+        mt19937 rng(42);
+        uniform_real_distribution<double> pixel(model.inputRange.lo, model.inputRange.hi);
+
+        vector<double> stageMs(pipeline.Layers().size(), 0.0);
+        vector<uint32_t> stageLevels(pipeline.Layers().size(), 0);
+        double encryptMs = 0.0;
+        double inferenceMs = 0.0;
+        double decryptMs = 0.0;
+        double maxError = 0.0;
+        uint32_t agreements = 0;
+        fhe::PrecisionTracker tracker(pipeline.MultDepth());
+        fhe::BatchEncryptor encryptor(cc, keys.publicKey, pool);
+        vector<Ciphertext<DCRTPoly>> outputs;
+        vector<vector<double>> expectedLogits;
+
+        for (uint32_t image = 0; image < numImages; image++) {
+            fhe::PlainGrid X(model.inputRows, vector<double>(model.inputCols));
+            for (auto& row : X) {
+                for (auto& x : row) {
+                    x = pixel(rng);
+                }
+            }
+
+            auto start = chrono::steady_clock::now();
+            fhe::CiphertextGrid encryptedX = encryptor.EncryptGrid(X);
+            encryptMs += elapsedMs(start);
+
+            start = chrono::steady_clock::now();
+            vector<fhe::StageReport> reports;
+            vector<fhe::CiphertextGrid> stages = pipeline.Run(cc, encryptedX, &reports, rotationKeys.get());
+            inferenceMs += elapsedMs(start);
+            for (size_t i = 0; i < reports.size(); i++) {
+                stageMs[i] += reports[i].milliseconds;
+                stageLevels[i] = reports[i].levelsConsumed;
+            }
+
+            tracker.MeasureRun(cc, keys.secretKey, pipeline, X, stages);
+
+            // The last stage is a dense layer, packed in a single ciphertext.
+            outputs.push_back(stages.back()[0][0]);
+            expectedLogits.push_back(pipeline.Reference(X).back()[0]);
+        }
+
+        // All logits at once, straight into one flat buffer of numImages x classes.
+        const uint32_t classes = expectedLogits.empty() ? 0 : expectedLogits[0].size();
+        auto start = chrono::steady_clock::now();
+        vector<double> allLogits = fhe::BatchDecryptor(cc, keys.secretKey, pool).DecryptPrefix(outputs, classes);
+        decryptMs = elapsedMs(start);
+        for (uint32_t image = 0; image < numImages; image++) {
+            const vector<double>& expected = expectedLogits[image];
+            auto logits = allLogits.begin() + static_cast<size_t>(image) * classes;
+            for (size_t j = 0; j < classes; j++) {
+                maxError = max(maxError, abs(logits[j] - expected[j]));
+            }
+            if (max_element(logits, logits + classes) - logits ==
+                max_element(expected.begin(), expected.end()) - expected.begin()) {
+                agreements++;
+            }
+        }
+
+        cout << "\nPer-layer latency (mean over " << numImages << " images):" << endl;
+        cout << left << setw(4) << "#" << setw(12) << "layer" << setw(14) << "ms" << "levels" << endl;
+        for (size_t i = 0; i < pipeline.Layers().size(); i++) {
+            cout << setw(4) << i << setw(12) << pipeline.Layers()[i]->Name() << setw(14) << stageMs[i] / numImages
+                 << stageLevels[i] << endl;
+        }
+        cout << right;
+
+        cout << "\nEncrypt: " << encryptMs / numImages << " ms/image | inference: " << inferenceMs / numImages
+             << " ms/image | decrypt: " << decryptMs / numImages << " ms/image" << endl;
+        cout << "Throughput: " << numImages / (inferenceMs / 1000.0) << " images/s (inference only), "
+             << numImages / ((encryptMs + inferenceMs + decryptMs) / 1000.0) << " images/s (end to end)" << endl;
+        cout << "Max logit error vs plaintext model: " << maxError << " | argmax agreement: " << agreements << "/"
+             << numImages << endl;
+
+        if (rotationKeys) {
+            fhe::RotationKeyStats keyStats = rotationKeys->Stats();
+            cout << "Rotation keys (budget " << rotationBudgetMb << " MB): " << keyStats.hits << " hits, "
+                 << keyStats.prefetched << " prefetched, " << keyStats.misses << " loaded on demand, "
+                 << keyStats.evictions << " evictions, peak " << keyStats.peakResidentBytes / (1024.0 * 1024.0)
+                 << " MB resident" << endl;
+            rotationKeys.reset();
+            fs::remove_all(rotationKeyDir);
+        }
+
+        cout << "\nPrecision and level budget per stage (worst over all images):" << endl;
+        tracker.Report(cout);
+
+#ifdef FHE_INSTRUMENTATION
+        // Op counts and times for every encryption, stage and decryption above.
+        ofstream profile("inference_profile.json");
+        fhe::Profiler::Instance().WriteJson(profile);
+        ofstream trace("inference_trace.json");
+        fhe::Profiler::Instance().WriteChromeTrace(trace);
+        cout << "Wrote inference_profile.json and inference_trace.json" << endl;
+#endif
+
+        if (maxError <= acceptable_error && agreements == numImages) {
+            cout << "\nEncrypted Inference Completed successfully." << endl;
+            cout << "Whoopee! Bad guys won't be able to steal my precious numbers 😊" << endl;
+        } else {
+            cout << "\nEncrypted Inference failing to get expected result. This can be due to unsufficient accuracy or wrong calculations" << endl;
+            cout << "🥺😢" << endl;
+        }
+
+    } catch (const exception& e) {
+        cerr << "Exception: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
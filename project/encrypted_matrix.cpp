@@ -0,0 +1,266 @@
+#include "encrypted_matrix.h"
+#include "instrumentation.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace lbcrypto;
+using namespace std;
+
+namespace fhe {
+
+namespace {
+
+size_t ciphertextCount(Packing packing, uint32_t rows, uint32_t cols) {
+    switch (packing) {
+        case Packing::Element:
+            return static_cast<size_t>(rows) * cols;
+        case Packing::Rows:
+            return rows;
+        case Packing::Columns:
+            return cols;
+        case Packing::Flat:
+            return 1;
+    }
+    return 0;
+}
+
+}  // namespace
+
+size_t slotsUsed(Packing packing, uint32_t rows, uint32_t cols) {
+    switch (packing) {
+        case Packing::Element:
+            return 1;
+        case Packing::Rows:
+            return cols;
+        case Packing::Columns:
+            return rows;
+        case Packing::Flat:
+            return static_cast<size_t>(rows) * cols;
+    }
+    return 0;
+}
+
+EncryptedMatrix::EncryptedMatrix(Packing packing, uint32_t rows, uint32_t cols,
+                                 vector<Ciphertext<DCRTPoly>> ciphertexts)
+    : packing(packing), rows(rows), cols(cols), ciphertexts(move(ciphertexts)) {
+    if (this->ciphertexts.size() != ciphertextCount(packing, rows, cols)) {
+        throw invalid_argument("EncryptedMatrix: expected " + to_string(ciphertextCount(packing, rows, cols)) +
+                               " ciphertexts, got " + to_string(this->ciphertexts.size()));
+    }
+}
+
+EncryptedMatrix EncryptedMatrix::Encrypt(const CryptoContext<DCRTPoly>& cc, const PublicKey<DCRTPoly>& publicKey,
+                                         const PlainGrid& values, Packing packing) {
+    const uint32_t rows = values.size();
+    const uint32_t cols = values.empty() ? 0 : values[0].size();
+    vector<Ciphertext<DCRTPoly>> ciphertexts;
+    for (const auto& slots : pack(values, packing, cc->GetEncodingParams()->GetBatchSize())) {
+        Plaintext ptx = FHE_OP(Encode, cc->MakeCKKSPackedPlaintext(slots));
+        ciphertexts.push_back(FHE_OP(Encrypt, cc->Encrypt(publicKey, ptx)));
+    }
+    return EncryptedMatrix(packing, rows, cols, move(ciphertexts));
+}
+
+EncryptedMatrix EncryptedMatrix::FromGrid(const CiphertextGrid& grid) {
+    const uint32_t rows = grid.size();
+    const uint32_t cols = grid.empty() ? 0 : grid[0].size();
+    vector<Ciphertext<DCRTPoly>> ciphertexts;
+    ciphertexts.reserve(static_cast<size_t>(rows) * cols);
+    for (const auto& row : grid) {
+        if (row.size() != cols) {
+            throw invalid_argument("EncryptedMatrix: ragged ciphertext grid");
+        }
+        ciphertexts.insert(ciphertexts.end(), row.begin(), row.end());
+    }
+    return EncryptedMatrix(Packing::Element, rows, cols, move(ciphertexts));
+}
+
+EncryptedMatrix EncryptedMatrix::EncryptIntegers(const CryptoContext<DCRTPoly>& cc,
+                                                 const PublicKey<DCRTPoly>& publicKey, const IntGrid& values,
+                                                 Packing packing) {
+    checkIntegerRange(cc, values);
+    const uint32_t rows = values.size();
+    const uint32_t cols = values.empty() ? 0 : values[0].size();
+    vector<Ciphertext<DCRTPoly>> ciphertexts;
+    for (const auto& slots : pack(values, packing, cc->GetEncodingParams()->GetBatchSize())) {
+        Plaintext ptx = FHE_OP(Encode, cc->MakePackedPlaintext(slots));
+        ciphertexts.push_back(FHE_OP(Encrypt, cc->Encrypt(publicKey, ptx)));
+    }
+    return EncryptedMatrix(packing, rows, cols, move(ciphertexts));
+}
+
+PlainGrid EncryptedMatrix::Decrypt(const CryptoContext<DCRTPoly>& cc, const PrivateKey<DCRTPoly>& secretKey) const {
+    const size_t used = slotsUsed(packing, rows, cols);
+    vector<vector<double>> slots;
+    slots.reserve(ciphertexts.size());
+    for (const auto& ct : ciphertexts) {
+        Plaintext result;
+        FHE_OP(Decrypt, cc->Decrypt(secretKey, ct, &result));
+        result->SetLength(used);
+        vector<double> values(used);
+        const auto& packed = result->GetCKKSPackedValue();
+        for (size_t i = 0; i < used; i++) {
+            values[i] = packed[i].real();
+        }
+        slots.push_back(move(values));
+    }
+    return unpack(slots, packing, rows, cols);
+}
+
+IntGrid EncryptedMatrix::DecryptIntegers(const CryptoContext<DCRTPoly>& cc,
+                                        const PrivateKey<DCRTPoly>& secretKey) const {
+    const size_t used = slotsUsed(packing, rows, cols);
+    vector<vector<int64_t>> slots;
+    slots.reserve(ciphertexts.size());
+    for (const auto& ct : ciphertexts) {
+        Plaintext result;
+        FHE_OP(Decrypt, cc->Decrypt(secretKey, ct, &result));
+        result->SetLength(used);
+        const auto& packed = result->GetPackedValue();
+        slots.emplace_back(packed.begin(), packed.begin() + used);
+    }
+    return unpack(slots, packing, rows, cols);
+}
+
+CiphertextGrid EncryptedMatrix::ToGrid() const {
+    if (packing != Packing::Element) {
+        throw logic_error("EncryptedMatrix::ToGrid: only Element packing maps onto a ciphertext grid");
+    }
+    CiphertextGrid grid(rows, vector<Ciphertext<DCRTPoly>>(cols));
+    for (uint32_t i = 0; i < rows; i++) {
+        for (uint32_t j = 0; j < cols; j++) {
+            grid[i][j] = ciphertexts[static_cast<size_t>(i) * cols + j];
+        }
+    }
+    return grid;
+}
+
+template <typename T>
+vector<vector<T>> pack(const vector<vector<T>>& values, Packing packing, uint32_t batchSize) {
+    const uint32_t rows = values.size();
+    const uint32_t cols = values.empty() ? 0 : values[0].size();
+    for (const auto& row : values) {
+        if (row.size() != cols) {
+            throw invalid_argument("pack: ragged matrix");
+        }
+    }
+    if (slotsUsed(packing, rows, cols) > batchSize) {
+        throw invalid_argument("pack: " + to_string(rows) + "x" + to_string(cols) +
+                               " matrix does not fit the batch size " + to_string(batchSize));
+    }
+
+    vector<vector<T>> slots;
+    switch (packing) {
+        case Packing::Element:
+            for (const auto& row : values) {
+                for (T v : row) {
+                    slots.emplace_back(batchSize, v);
+                }
+            }
+            break;
+        case Packing::Rows:
+            slots = values;
+            break;
+        case Packing::Columns:
+            slots.assign(cols, vector<T>(rows));
+            for (uint32_t i = 0; i < rows; i++) {
+                for (uint32_t j = 0; j < cols; j++) {
+                    slots[j][i] = values[i][j];
+                }
+            }
+            break;
+        case Packing::Flat:
+            slots.emplace_back();
+            for (const auto& row : values) {
+                slots[0].insert(slots[0].end(), row.begin(), row.end());
+            }
+            break;
+    }
+    return slots;
+}
+
+template <typename T>
+vector<vector<T>> unpack(const vector<vector<T>>& slots, Packing packing, uint32_t rows, uint32_t cols) {
+    vector<vector<T>> values(rows, vector<T>(cols));
+    for (uint32_t i = 0; i < rows; i++) {
+        for (uint32_t j = 0; j < cols; j++) {
+            switch (packing) {
+                case Packing::Element:
+                    values[i][j] = slots[static_cast<size_t>(i) * cols + j][0];
+                    break;
+                case Packing::Rows:
+                    values[i][j] = slots[i][j];
+                    break;
+                case Packing::Columns:
+                    values[i][j] = slots[j][i];
+                    break;
+                case Packing::Flat:
+                    values[i][j] = slots[0][static_cast<size_t>(i) * cols + j];
+                    break;
+            }
+        }
+    }
+    return values;
+}
+
+template vector<vector<double>> pack(const PlainGrid&, Packing, uint32_t);
+template vector<vector<int64_t>> pack(const IntGrid&, Packing, uint32_t);
+template PlainGrid unpack(const vector<vector<double>>&, Packing, uint32_t, uint32_t);
+template IntGrid unpack(const vector<vector<int64_t>>&, Packing, uint32_t, uint32_t);
+
+void checkIntegerRange(const CryptoContext<DCRTPoly>& cc, const IntGrid& values) {
+    const int64_t t = cc->GetEncodingParams()->GetPlaintextModulus();
+    for (const auto& row : values) {
+        for (int64_t v : row) {
+            if (v <= -t / 2 - t % 2 || v > t / 2) {
+                throw invalid_argument("checkIntegerRange: " + to_string(v) + " does not fit the plaintext modulus " +
+                                       to_string(t));
+            }
+        }
+    }
+}
+
+int64_t maxMagnitude(const IntGrid& values) {
+    int64_t magnitude = 0;
+    for (const auto& row : values) {
+        for (int64_t v : row) {
+            magnitude = max(magnitude, v < 0 ? -v : v);
+        }
+    }
+    return magnitude;
+}
+
+void checkIntegerBound(const CryptoContext<DCRTPoly>& cc, double bound, const string& what) {
+    // Both ends of [-bound, bound] must lie in (-t/2, t/2].
+    const int64_t t = cc->GetEncodingParams()->GetPlaintextModulus();
+    if (bound >= t / 2.0) {
+        throw invalid_argument(what + ": results up to " + to_string(static_cast<uint64_t>(bound)) +
+                               " in magnitude would wrap mod the plaintext modulus " + to_string(t));
+    }
+}
+
+CiphertextGrid encryptGrid(const CryptoContext<DCRTPoly>& cc, const PublicKey<DCRTPoly>& publicKey,
+                           const PlainGrid& values) {
+    return EncryptedMatrix::Encrypt(cc, publicKey, values, Packing::Element).ToGrid();
+}
+
+PlainGrid decryptGrid(const CryptoContext<DCRTPoly>& cc, const PrivateKey<DCRTPoly>& secretKey,
+                      const CiphertextGrid& grid) {
+    return EncryptedMatrix::FromGrid(grid).Decrypt(cc, secretKey);
+}
+
+vector<double> decryptPacked(const CryptoContext<DCRTPoly>& cc, const PrivateKey<DCRTPoly>& secretKey,
+                             const Ciphertext<DCRTPoly>& ciphertext, size_t length) {
+    Plaintext result;
+    FHE_OP(Decrypt, cc->Decrypt(secretKey, ciphertext, &result));
+    result->SetLength(length);
+    vector<double> values(length);
+    const auto& slots = result->GetCKKSPackedValue();
+    for (size_t i = 0; i < length; i++) {
+        values[i] = slots[i].real();
+    }
+    return values;
+}
+
+}  // namespace fhe
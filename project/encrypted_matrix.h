@@ -0,0 +1,109 @@
+#pragma once
+
+#include "openfhe.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fhe {
+
+// A 2D tensor with one ciphertext per element. The value is replicated across
+// the batch slots, so slot-wise constants and plaintext masks need no
+// bookkeeping. A layer may instead return a 1x1 grid holding a packed vector
+// (element i in slot i); see DenseLayer.
+using CiphertextGrid = std::vector<std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>>>;
+using PlainGrid = std::vector<std::vector<double>>;
+// Integer matrix for the BFV and BGV schemes, whose slots hold integers mod
+// the plaintext modulus t and compute on them exactly.
+using IntGrid = std::vector<std::vector<int64_t>>;
+
+// How the elements of a matrix are laid out over ciphertexts.
+enum class Packing {
+    // One ciphertext per element, the value replicated across the batch.
+    Element,
+    // One ciphertext per row, element (i, j) in slot j of ciphertext i.
+    Rows,
+    // One ciphertext per column, element (i, j) in slot i of ciphertext j.
+    Columns,
+    // The whole matrix row-major in a single ciphertext.
+    Flat,
+};
+
+// Encrypted rows x cols matrix in one of the Packing layouts. Element packing
+// stores the ciphertexts row-major.
+class EncryptedMatrix {
+public:
+    EncryptedMatrix() = default;
+    EncryptedMatrix(Packing packing, uint32_t rows, uint32_t cols,
+                    std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> ciphertexts);
+
+    static EncryptedMatrix Encrypt(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                                   const lbcrypto::PublicKey<lbcrypto::DCRTPoly>& publicKey, const PlainGrid& values,
+                                   Packing packing);
+
+    // BFV or BGV context; every value must lie in (-t/2, t/2].
+    static EncryptedMatrix EncryptIntegers(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                                           const lbcrypto::PublicKey<lbcrypto::DCRTPoly>& publicKey,
+                                           const IntGrid& values, Packing packing);
+
+    // Wraps an Element-packed grid without copying ciphertext data.
+    static EncryptedMatrix FromGrid(const CiphertextGrid& grid);
+
+    PlainGrid Decrypt(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                      const lbcrypto::PrivateKey<lbcrypto::DCRTPoly>& secretKey) const;
+    // Exact, as long as no result left (-t/2, t/2].
+    IntGrid DecryptIntegers(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                            const lbcrypto::PrivateKey<lbcrypto::DCRTPoly>& secretKey) const;
+
+    // Element packing only.
+    CiphertextGrid ToGrid() const;
+
+    Packing GetPacking() const { return packing; }
+    uint32_t Rows() const { return rows; }
+    uint32_t Cols() const { return cols; }
+    const std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>>& Ciphertexts() const { return ciphertexts; }
+    const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& At(size_t index) const { return ciphertexts[index]; }
+
+private:
+    Packing packing = Packing::Element;
+    uint32_t rows = 0;
+    uint32_t cols = 0;
+    std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> ciphertexts;
+};
+
+// Number of slots each ciphertext uses.
+size_t slotsUsed(Packing packing, uint32_t rows, uint32_t cols);
+
+// Slot vectors for `values` in the given packing, one per ciphertext. T is
+// double or int64_t.
+template <typename T>
+std::vector<std::vector<T>> pack(const std::vector<std::vector<T>>& values, Packing packing, uint32_t batchSize);
+
+// Inverse of pack(); `slots` holds at least the used slots of each ciphertext.
+template <typename T>
+std::vector<std::vector<T>> unpack(const std::vector<std::vector<T>>& slots, Packing packing, uint32_t rows,
+                                   uint32_t cols);
+
+// Throws unless every value is representable mod the plaintext modulus of
+// `cc`, i.e. lies in (-t/2, t/2].
+void checkIntegerRange(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc, const IntGrid& values);
+
+// Largest |value| in `values`.
+int64_t maxMagnitude(const IntGrid& values);
+
+// Throws unless every result of magnitude up to `bound` is representable mod
+// the plaintext modulus of `cc`; `what` names the computation in the error.
+void checkIntegerBound(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc, double bound, const std::string& what);
+
+CiphertextGrid encryptGrid(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                           const lbcrypto::PublicKey<lbcrypto::DCRTPoly>& publicKey, const PlainGrid& values);
+
+PlainGrid decryptGrid(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                      const lbcrypto::PrivateKey<lbcrypto::DCRTPoly>& secretKey, const CiphertextGrid& grid);
+
+// Decrypts the first `length` slots of a packed ciphertext.
+std::vector<double> decryptPacked(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                                  const lbcrypto::PrivateKey<lbcrypto::DCRTPoly>& secretKey,
+                                  const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& ciphertext, size_t length);
+
+}  // namespace fhe
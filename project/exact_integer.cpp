@@ -0,0 +1,216 @@
+#include "openfhe.h"
+#include "pipeline.h"
+#include "batch_crypto.h"
+#include "kernels.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <string>
+
+using namespace lbcrypto;
+using namespace std;
+
+// The integer matmul and convolution workloads of the demos under CKKS, BFV
+// and BGV. BFV and BGV must reproduce the plaintext results exactly; CKKS is
+// only close. Prints the time of every scheme relative to CKKS.
+// Usage: exact_integer [n=8] [repetitions=3]
+
+const uint64_t plaintextModulus = 65537;
+
+struct Timings {
+    uint32_t ringDim = 0;
+    double keygenMs = 0.0;
+    double matmulMs = 0.0;
+    double convMs = 0.0;
+    // Largest deviation from the plaintext results.
+    double maxError = 0.0;
+};
+
+double elapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+template <typename F>
+double meanMs(uint32_t repetitions, F&& f) {
+    auto start = chrono::steady_clock::now();
+    for (uint32_t r = 0; r < repetitions; r++) {
+        f();
+    }
+    return elapsedMs(start) / repetitions;
+}
+
+fhe::IntGrid multiply(const fhe::IntGrid& a, const fhe::IntGrid& b) {
+    fhe::IntGrid c(a.size(), vector<int64_t>(b[0].size(), 0));
+    for (size_t i = 0; i < a.size(); i++) {
+        for (size_t j = 0; j < b[0].size(); j++) {
+            for (size_t k = 0; k < b.size(); k++) {
+                c[i][j] += a[i][k] * b[k][j];
+            }
+        }
+    }
+    return c;
+}
+
+fhe::IntGrid convolve(const fhe::IntGrid& x, const fhe::IntGrid& kernel, int64_t bias) {
+    const size_t outRows = x.size() - kernel.size() + 1;
+    const size_t outCols = x[0].size() - kernel[0].size() + 1;
+    fhe::IntGrid y(outRows, vector<int64_t>(outCols, bias));
+    for (size_t i = 0; i < outRows; i++) {
+        for (size_t j = 0; j < outCols; j++) {
+            for (size_t m = 0; m < kernel.size(); m++) {
+                for (size_t n = 0; n < kernel[0].size(); n++) {
+                    y[i][j] += x[i + m][j + n] * kernel[m][n];
+                }
+            }
+        }
+    }
+    return y;
+}
+
+fhe::PlainGrid toPlain(const fhe::IntGrid& values) {
+    fhe::PlainGrid plain;
+    for (const auto& row : values) {
+        plain.emplace_back(row.begin(), row.end());
+    }
+    return plain;
+}
+
+template <typename T>
+double maxDeviation(const vector<vector<T>>& result, const fhe::IntGrid& expected) {
+    double deviation = 0.0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        for (size_t j = 0; j < expected[i].size(); j++) {
+            deviation = max(deviation, abs(static_cast<double>(result[i][j]) - static_cast<double>(expected[i][j])));
+        }
+    }
+    return deviation;
+}
+
+// Runs both kernels in the given context; `integers` selects the exact
+// encoding of BFV and BGV.
+Timings run(const CryptoContext<DCRTPoly>& cc, bool integers, const fhe::IntGrid& A, const fhe::IntGrid& B,
+            const fhe::IntGrid& X, const fhe::IntGrid& K, int64_t bias, uint32_t repetitions) {
+    cc->Enable(PKE);
+    cc->Enable(KEYSWITCH);
+    cc->Enable(LEVELEDSHE);
+    cc->Enable(ADVANCEDSHE);
+
+    Timings timings;
+    timings.ringDim = cc->GetRingDimension();
+    KeyPair<DCRTPoly> keys;
+    auto start = chrono::steady_clock::now();
+    keys = cc->KeyGen();
+    cc->EvalMultKeyGen(keys.secretKey);
+    cc->EvalSumKeyGen(keys.secretKey);
+    timings.keygenMs = elapsedMs(start);
+
+    fhe::ThreadPool pool;
+    fhe::BatchEncryptor encryptor(cc, keys.publicKey, pool);
+    fhe::BatchDecryptor decryptor(cc, keys.secretKey, pool);
+    auto encrypt = [&](const fhe::IntGrid& values, fhe::Packing packing) {
+        return integers ? encryptor.EncryptIntegers(values, packing) : encryptor.Encrypt(toPlain(values), packing);
+    };
+    auto deviation = [&](const fhe::EncryptedMatrix& result, const fhe::IntGrid& expected) {
+        return integers ? maxDeviation(decryptor.DecryptIntegers(result), expected)
+                        : maxDeviation(decryptor.Decrypt(result), expected);
+    };
+
+    fhe::EncryptedMatrix encryptedA = encrypt(A, fhe::Packing::Rows);
+    fhe::EncryptedMatrix encryptedB = encrypt(B, fhe::Packing::Columns);
+    fhe::EncryptedMatrix encryptedC;
+    timings.matmulMs = meanMs(repetitions, [&] {
+        encryptedC = integers ? fhe::matMul(cc, encryptedA, encryptedB, fhe::maxMagnitude(A), fhe::maxMagnitude(B),
+                                            fhe::Accumulation::Lazy, &pool)
+                              : fhe::matMul(cc, encryptedA, encryptedB, fhe::Accumulation::Lazy, &pool);
+    });
+
+    fhe::CiphertextGrid encryptedX = encrypt(X, fhe::Packing::Element).ToGrid();
+    fhe::CiphertextGrid encryptedY;
+    timings.convMs = meanMs(repetitions, [&] {
+        encryptedY = integers ? fhe::conv2d(cc, encryptedX, K, bias, fhe::maxMagnitude(X), &pool)
+                              : fhe::conv2d(cc, encryptedX, toPlain(K), static_cast<double>(bias), &pool);
+    });
+
+    timings.maxError = max(deviation(encryptedC, multiply(A, B)),
+                           deviation(fhe::EncryptedMatrix::FromGrid(encryptedY), convolve(X, K, bias)));
+    return timings;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        const uint32_t n = argc > 1 ? stoul(argv[1]) : 8;
+        const uint32_t repetitions = argc > 2 ? max(1ul, stoul(argv[2])) : 3;
+
+        // Small integer matrices, as in the matmul and convolution demos.
+        mt19937 rng(11);
+        uniform_int_distribution<int64_t> entry(-9, 9);
+        fhe::IntGrid A(n, vector<int64_t>(n));
+        fhe::IntGrid B(n, vector<int64_t>(n));
+        fhe::IntGrid X(n, vector<int64_t>(n));
+        for (uint32_t i = 0; i < n; i++) {
+            for (uint32_t j = 0; j < n; j++) {
+                A[i][j] = entry(rng);
+                B[i][j] = entry(rng);
+                X[i][j] = entry(rng);
+            }
+        }
+        fhe::IntGrid K = {{1, 0, -1}, {2, 0, -2}, {1, 0, -1}};
+        const int64_t bias = 3;
+
+        // Both kernels take one multiplication; a row must fit the batch.
+        uint32_t batchSize = 1;
+        while (batchSize < n) {
+            batchSize <<= 1;
+        }
+        const uint32_t multDepth = 1;
+        const uint32_t scaleModSize = 50;
+
+        vector<pair<string, Timings>> results;
+        results.emplace_back(
+            "CKKS", run(GenCryptoContext(fhe::makeParameters(multDepth, scaleModSize, batchSize)), false, A, B, X, K,
+                        bias, repetitions));
+        results.emplace_back(
+            "BFV",
+            run(GenCryptoContext(fhe::makeIntegerParameters<CryptoContextBFVRNS>(multDepth, plaintextModulus, batchSize)),
+                true, A, B, X, K, bias, repetitions));
+        results.emplace_back(
+            "BGV",
+            run(GenCryptoContext(fhe::makeIntegerParameters<CryptoContextBGVRNS>(multDepth, plaintextModulus, batchSize)),
+                true, A, B, X, K, bias, repetitions));
+
+        const Timings& ckks = results[0].second;
+        cout << n << "x" << n << " matmul and 3x3 convolution, mean of " << repetitions << " runs" << endl;
+        cout << left << setw(6) << "scheme" << right << setw(10) << "ring dim" << setw(12) << "keygen ms" << setw(12)
+             << "matmul ms" << setw(10) << "vs CKKS" << setw(10) << "conv ms" << setw(10) << "vs CKKS" << setw(12)
+             << "max error" << endl;
+        bool success = true;
+        for (const auto& [scheme, t] : results) {
+            cout << left << setw(6) << scheme << right << setw(10) << t.ringDim << fixed << setprecision(2)
+                 << setw(12) << t.keygenMs << setw(12) << t.matmulMs << setw(9) << t.matmulMs / ckks.matmulMs << "x"
+                 << setw(10) << t.convMs << setw(9) << t.convMs / ckks.convMs << "x" << scientific << setprecision(1)
+                 << setw(12) << t.maxError << defaultfloat << endl;
+            // CKKS only has to come close; the integer schemes must be exact.
+            if (scheme == "CKKS" ? t.maxError > 1e-3 : t.maxError != 0.0) {
+                success = false;
+            }
+        }
+
+        if (success) {
+            cout << "\nExact Integer Arithmetic Completed successfully." << endl;
+            cout << "Whoopee! Bad guys won't be able to steal my precious numbers 😊" << endl;
+        } else {
+            cout << "\nExact Integer Arithmetic failing to get expected result. This can be due to unsufficient accuracy or wrong calculations" << endl;
+            cout << "🥺😢" << endl;
+        }
+
+    } catch (const exception& e) {
+        cerr << "Exception: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,513 @@
+#include "expression_graph.h"
+#include "instrumentation.h"
+#include "task_graph.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+using namespace lbcrypto;
+using namespace std;
+
+namespace fhe {
+
+// Node table that folds constants as nodes are created and hands out the
+// existing node for an operation it has already seen.
+class ExpressionGraph::Builder {
+public:
+    Node Input(uint32_t index) { return Intern({Kind::Input, index, 0, 0.0}); }
+
+    // -0.0 and 0.0 are the same constant.
+    Node Constant(double value) { return Intern({Kind::Constant, 0, 0, value == 0.0 ? 0.0 : value}); }
+
+    Node Add(Node a, Node b) {
+        Canonicalize(a, b);
+        if (IsConstant(a)) {
+            return Constant(nodes[a].value + nodes[b].value);
+        }
+        if (IsConstant(b)) {
+            const double c = nodes[b].value;
+            if (c == 0.0) {
+                return a;
+            }
+            // (x + d) + c = x + (d + c)
+            const NodeData inner = nodes[a];
+            if (inner.kind == Kind::Add && IsConstant(inner.b)) {
+                return Add(inner.a, Constant(nodes[inner.b].value + c));
+            }
+        }
+        return Intern({Kind::Add, a, b, 0.0});
+    }
+
+    Node Mult(Node a, Node b) {
+        Canonicalize(a, b);
+        if (IsConstant(a)) {
+            return Constant(nodes[a].value * nodes[b].value);
+        }
+        if (IsConstant(b)) {
+            const double c = nodes[b].value;
+            if (c == 0.0) {
+                return Constant(0.0);
+            }
+            if (c == 1.0) {
+                return a;
+            }
+            // (x * d) * c = x * (d * c)
+            const NodeData inner = nodes[a];
+            if (inner.kind == Kind::Mult && IsConstant(inner.b)) {
+                return Mult(inner.a, Constant(nodes[inner.b].value * c));
+            }
+        }
+        return Intern({Kind::Mult, a, b, 0.0});
+    }
+
+    bool IsConstant(Node node) const { return nodes[node].kind == Kind::Constant; }
+    uint32_t Depth(Node node) const { return depths[node]; }
+
+    vector<NodeData> nodes;
+
+private:
+    using Key = tuple<Kind, Node, Node, uint64_t>;
+
+    // Constants go second; otherwise the older node goes first.
+    void Canonicalize(Node& a, Node& b) const {
+        if ((IsConstant(a) && !IsConstant(b)) || (IsConstant(a) == IsConstant(b) && a > b)) {
+            swap(a, b);
+        }
+    }
+
+    Node Intern(const NodeData& node) {
+        uint64_t bits;
+        memcpy(&bits, &node.value, sizeof(bits));
+        auto [it, inserted] = interned.emplace(Key{node.kind, node.a, node.b, bits}, Node(nodes.size()));
+        if (inserted) {
+            nodes.push_back(node);
+            // Only Input and constants are leaves, and constant operands are
+            // folded away, so a Mult with a constant operand is a scalar product.
+            uint32_t depth = 0;
+            if (node.kind == Kind::Add) {
+                depth = max(depths[node.a], depths[node.b]);
+            } else if (node.kind == Kind::Mult) {
+                depth = max(depths[node.a], depths[node.b]) + 1;
+            }
+            depths.push_back(depth);
+        }
+        return it->second;
+    }
+
+    map<Key, Node> interned;
+    vector<uint32_t> depths;
+};
+
+ExpressionGraph::Node ExpressionGraph::Append(const NodeData& node) {
+    nodes.push_back(node);
+    return nodes.size() - 1;
+}
+
+void ExpressionGraph::CheckNode(Node node) const {
+    if (node >= nodes.size()) {
+        throw out_of_range("ExpressionGraph: unknown node " + to_string(node));
+    }
+}
+
+ExpressionGraph::Node ExpressionGraph::Input() {
+    return Append({Kind::Input, inputCount++, 0, 0.0});
+}
+
+ExpressionGraph::Node ExpressionGraph::Constant(double value) {
+    return Append({Kind::Constant, 0, 0, value});
+}
+
+ExpressionGraph::Node ExpressionGraph::Add(Node a, Node b) {
+    CheckNode(a);
+    CheckNode(b);
+    return Append({Kind::Add, a, b, 0.0});
+}
+
+ExpressionGraph::Node ExpressionGraph::Mult(Node a, Node b) {
+    CheckNode(a);
+    CheckNode(b);
+    return Append({Kind::Mult, a, b, 0.0});
+}
+
+ExpressionGraph::Node ExpressionGraph::Sum(const vector<Node>& terms) {
+    if (terms.empty()) {
+        return Constant(0.0);
+    }
+    Node sum = terms[0];
+    for (size_t i = 1; i < terms.size(); i++) {
+        sum = Add(sum, terms[i]);
+    }
+    return sum;
+}
+
+ExpressionGraph::Node ExpressionGraph::Polynomial(Node x, const vector<double>& coefficients) {
+    Node sum = Constant(coefficients.empty() ? 0.0 : coefficients[0]);
+    Node power = x;
+    for (size_t k = 1; k < coefficients.size(); k++) {
+        if (k > 1) {
+            power = Mult(power, x);
+        }
+        sum = Add(sum, Mult(power, Constant(coefficients[k])));
+    }
+    return sum;
+}
+
+size_t ExpressionGraph::Output(Node node) {
+    CheckNode(node);
+    outputs.push_back(node);
+    return outputs.size() - 1;
+}
+
+vector<bool> ExpressionGraph::Reachable() const {
+    // Operands always precede their users, so one backward sweep suffices.
+    vector<bool> reachable(nodes.size(), false);
+    for (Node output : outputs) {
+        reachable[output] = true;
+    }
+    for (size_t id = nodes.size(); id-- > 0;) {
+        const NodeData& node = nodes[id];
+        if (reachable[id] && (node.kind == Kind::Add || node.kind == Kind::Mult)) {
+            reachable[node.a] = true;
+            reachable[node.b] = true;
+        }
+    }
+    return reachable;
+}
+
+void ExpressionGraph::Analyze(vector<uint32_t>& depths, vector<bool>& plain) const {
+    depths.assign(nodes.size(), 0);
+    plain.assign(nodes.size(), false);
+    for (size_t id = 0; id < nodes.size(); id++) {
+        const NodeData& node = nodes[id];
+        switch (node.kind) {
+            case Kind::Input:
+                break;
+            case Kind::Constant:
+                plain[id] = true;
+                break;
+            case Kind::Add:
+                plain[id] = plain[node.a] && plain[node.b];
+                depths[id] = max(depths[node.a], depths[node.b]);
+                break;
+            case Kind::Mult:
+                plain[id] = plain[node.a] && plain[node.b];
+                depths[id] = plain[id] ? 0 : max(depths[node.a], depths[node.b]) + 1;
+                break;
+        }
+    }
+}
+
+size_t ExpressionGraph::Operations() const {
+    vector<uint32_t> depths;
+    vector<bool> plain;
+    Analyze(depths, plain);
+    vector<bool> reachable = Reachable();
+    size_t operations = 0;
+    for (size_t id = 0; id < nodes.size(); id++) {
+        if (reachable[id] && !plain[id] && nodes[id].kind != Kind::Input) {
+            operations++;
+        }
+    }
+    return operations;
+}
+
+uint32_t ExpressionGraph::Depth() const {
+    vector<uint32_t> depths;
+    vector<bool> plain;
+    Analyze(depths, plain);
+    uint32_t depth = 0;
+    for (Node output : outputs) {
+        depth = max(depth, depths[output]);
+    }
+    return depth;
+}
+
+GraphStats ExpressionGraph::Optimize() {
+    GraphStats stats;
+    stats.operationsBefore = Operations();
+    stats.depthBefore = Depth();
+
+    // Constant folding, zero-weight elimination and CSE in one bottom-up pass.
+    Builder folded;
+    vector<Node> renamed(nodes.size());
+    for (size_t id = 0; id < nodes.size(); id++) {
+        const NodeData& node = nodes[id];
+        switch (node.kind) {
+            case Kind::Input:
+                renamed[id] = folded.Input(node.a);
+                break;
+            case Kind::Constant:
+                renamed[id] = folded.Constant(node.value);
+                break;
+            case Kind::Add:
+                renamed[id] = folded.Add(renamed[node.a], renamed[node.b]);
+                break;
+            case Kind::Mult:
+                renamed[id] = folded.Mult(renamed[node.a], renamed[node.b]);
+                break;
+        }
+    }
+    nodes = move(folded.nodes);
+    for (Node& output : outputs) {
+        output = renamed[output];
+    }
+
+    // Depth balancing. A product chain runs through every Mult that has no
+    // other consumer; shared products stay intact so their work is not repeated.
+    vector<bool> reachable = Reachable();
+    vector<uint32_t> uses(nodes.size(), 0);
+    for (size_t id = 0; id < nodes.size(); id++) {
+        if (reachable[id] && (nodes[id].kind == Kind::Add || nodes[id].kind == Kind::Mult)) {
+            uses[nodes[id].a]++;
+            uses[nodes[id].b]++;
+        }
+    }
+    for (Node output : outputs) {
+        uses[output]++;
+    }
+
+    Builder balanced;
+    const Node none = numeric_limits<Node>::max();
+    vector<Node> memo(nodes.size(), none);
+    function<Node(Node)> balance;
+    function<void(Node, bool, vector<Node>&, double&)> collect = [&](Node id, bool root, vector<Node>& factors,
+                                                                     double& scalar) {
+        const NodeData& node = nodes[id];
+        if (node.kind == Kind::Constant) {
+            scalar *= node.value;
+        } else if (node.kind == Kind::Mult && (root || uses[id] == 1)) {
+            collect(node.a, false, factors, scalar);
+            collect(node.b, false, factors, scalar);
+        } else {
+            factors.push_back(balance(id));
+        }
+    };
+    // Multiplies the two shallowest factors until one is left.
+    auto combine = [&](const vector<Node>& factors) {
+        using Entry = pair<uint32_t, Node>;
+        priority_queue<Entry, vector<Entry>, greater<Entry>> queue;
+        for (Node factor : factors) {
+            queue.emplace(balanced.Depth(factor), factor);
+        }
+        while (queue.size() > 1) {
+            Node x = queue.top().second;
+            queue.pop();
+            Node y = queue.top().second;
+            queue.pop();
+            Node product = balanced.Mult(x, y);
+            queue.emplace(balanced.Depth(product), product);
+        }
+        return queue.empty() ? balanced.Constant(1.0) : queue.top().second;
+    };
+    balance = [&](Node id) {
+        if (memo[id] != none) {
+            return memo[id];
+        }
+        const NodeData& node = nodes[id];
+        Node result = none;
+        switch (node.kind) {
+            case Kind::Input:
+                result = balanced.Input(node.a);
+                break;
+            case Kind::Constant:
+                result = balanced.Constant(node.value);
+                break;
+            case Kind::Add:
+                result = balanced.Add(balance(node.a), balance(node.b));
+                break;
+            case Kind::Mult: {
+                vector<Node> factors;
+                double scalar = 1.0;
+                collect(id, true, factors, scalar);
+                result = balanced.Mult(combine(factors), balanced.Constant(scalar));
+                // A scalar applied last costs a level on top of the product;
+                // folded into the shallowest factor it may come for free.
+                if (scalar != 1.0 && !factors.empty()) {
+                    auto shallowest = min_element(factors.begin(), factors.end(), [&](Node x, Node y) {
+                        return balanced.Depth(x) < balanced.Depth(y);
+                    });
+                    *shallowest = balanced.Mult(*shallowest, balanced.Constant(scalar));
+                    Node scaledFirst = combine(factors);
+                    if (balanced.Depth(scaledFirst) < balanced.Depth(result)) {
+                        result = scaledFirst;
+                    }
+                }
+                break;
+            }
+        }
+        memo[id] = result;
+        return result;
+    };
+    for (Node& output : outputs) {
+        output = balance(output);
+    }
+    nodes = move(balanced.nodes);
+
+    // Drop nodes that folding and balancing left without consumers.
+    reachable = Reachable();
+    renamed.assign(nodes.size(), 0);
+    vector<NodeData> compacted;
+    for (size_t id = 0; id < nodes.size(); id++) {
+        if (reachable[id]) {
+            NodeData node = nodes[id];
+            if (node.kind == Kind::Add || node.kind == Kind::Mult) {
+                node.a = renamed[node.a];
+                node.b = renamed[node.b];
+            }
+            renamed[id] = compacted.size();
+            compacted.push_back(node);
+        }
+    }
+    nodes = move(compacted);
+    for (Node& output : outputs) {
+        output = renamed[output];
+    }
+
+    stats.operationsAfter = Operations();
+    stats.depthAfter = Depth();
+    return stats;
+}
+
+vector<Ciphertext<DCRTPoly>> ExpressionGraph::Evaluate(const CryptoContext<DCRTPoly>& cc,
+                                                       const vector<Ciphertext<DCRTPoly>>& inputs,
+                                                       ThreadPool* pool) const {
+    if (inputs.size() != inputCount) {
+        throw invalid_argument("ExpressionGraph: expected " + to_string(inputCount) + " inputs, got " +
+                               to_string(inputs.size()));
+    }
+    vector<uint32_t> depths;
+    vector<bool> plain;
+    Analyze(depths, plain);
+    for (size_t i = 0; i < outputs.size(); i++) {
+        if (plain[outputs[i]]) {
+            throw logic_error("ExpressionGraph: output " + to_string(i) + " does not depend on any input");
+        }
+    }
+
+    // Remaining consumers of every ciphertext; outputs count as one each.
+    vector<bool> reachable = Reachable();
+    unique_ptr<atomic<uint32_t>[]> uses(new atomic<uint32_t>[nodes.size()]);
+    for (size_t id = 0; id < nodes.size(); id++) {
+        uses[id] = 0;
+    }
+    for (size_t id = 0; id < nodes.size(); id++) {
+        if (reachable[id] && (nodes[id].kind == Kind::Add || nodes[id].kind == Kind::Mult)) {
+            uses[nodes[id].a]++;
+            uses[nodes[id].b]++;
+        }
+    }
+    for (Node output : outputs) {
+        uses[output]++;
+    }
+
+    // Inputs and plain constants first; every remaining node is one
+    // homomorphic operation.
+    vector<Ciphertext<DCRTPoly>> values(nodes.size());
+    vector<double> constants(nodes.size(), 0.0);
+    vector<Node> operations;
+    for (size_t id = 0; id < nodes.size(); id++) {
+        const NodeData& node = nodes[id];
+        if (!reachable[id]) {
+            continue;
+        } else if (node.kind == Kind::Input) {
+            values[id] = inputs[node.a];
+        } else if (node.kind == Kind::Constant) {
+            constants[id] = node.value;
+        } else if (plain[id]) {
+            constants[id] = node.kind == Kind::Add ? constants[node.a] + constants[node.b]
+                                                   : constants[node.a] * constants[node.b];
+        } else {
+            operations.push_back(id);
+        }
+    }
+
+    auto release = [&](Node id) {
+        if (!plain[id] && --uses[id] == 0) {
+            values[id].reset();
+        }
+    };
+    auto run = [&](Node id) {
+        const NodeData& node = nodes[id];
+        const bool add = node.kind == Kind::Add;
+        if (plain[node.a] || plain[node.b]) {
+            const Node ct = plain[node.a] ? node.b : node.a;
+            const double c = plain[node.a] ? constants[node.a] : constants[node.b];
+            values[id] = add ? FHE_OP(EvalAdd, cc->EvalAdd(values[ct], c))
+                             : FHE_OP(EvalMult, cc->EvalMult(values[ct], c));
+            release(ct);
+        } else {
+            values[id] = add ? FHE_OP(EvalAdd, cc->EvalAdd(values[node.a], values[node.b]))
+                             : FHE_OP(EvalMult, cc->EvalMult(values[node.a], values[node.b]));
+            release(node.a);
+            release(node.b);
+        }
+    };
+
+    if (!pool) {
+        for (Node id : operations) {
+            run(id);
+        }
+    } else {
+        // One task per operation, depending on the operations that produce its operands.
+        TaskGraph tasks;
+        vector<TaskGraph::Task> taskOf(nodes.size());
+        for (Node id : operations) {
+            vector<TaskGraph::Task> dependencies;
+            for (Node operand : {nodes[id].a, nodes[id].b}) {
+                if (!plain[operand] && nodes[operand].kind != Kind::Input) {
+                    dependencies.push_back(taskOf[operand]);
+                }
+            }
+            taskOf[id] = tasks.Add([&run, id] { run(id); }, dependencies);
+        }
+        tasks.Run(*pool);
+    }
+
+    vector<Ciphertext<DCRTPoly>> results;
+    results.reserve(outputs.size());
+    for (Node output : outputs) {
+        results.push_back(values[output]);
+    }
+    return results;
+}
+
+vector<double> ExpressionGraph::Reference(const vector<double>& inputs) const {
+    if (inputs.size() != inputCount) {
+        throw invalid_argument("ExpressionGraph: expected " + to_string(inputCount) + " inputs, got " +
+                               to_string(inputs.size()));
+    }
+    vector<double> values(nodes.size(), 0.0);
+    for (size_t id = 0; id < nodes.size(); id++) {
+        const NodeData& node = nodes[id];
+        switch (node.kind) {
+            case Kind::Input:
+                values[id] = inputs[node.a];
+                break;
+            case Kind::Constant:
+                values[id] = node.value;
+                break;
+            case Kind::Add:
+                values[id] = values[node.a] + values[node.b];
+                break;
+            case Kind::Mult:
+                values[id] = values[node.a] * values[node.b];
+                break;
+        }
+    }
+    vector<double> results;
+    results.reserve(outputs.size());
+    for (Node output : outputs) {
+        results.push_back(values[output]);
+    }
+    return results;
+}
+
+}  // namespace fhe
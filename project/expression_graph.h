@@ -0,0 +1,99 @@
+#pragma once
+
+#include "openfhe.h"
+#include "thread_pool.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fhe {
+
+// Before/after figures from ExpressionGraph::Optimize().
+struct GraphStats {
+    // Homomorphic operations reachable from the outputs.
+    size_t operationsBefore = 0;
+    size_t operationsAfter = 0;
+    // Multiplicative depth of the deepest output.
+    uint32_t depthBefore = 0;
+    uint32_t depthAfter = 0;
+};
+
+// Element-wise CKKS computation recorded lazily as a DAG over single
+// ciphertexts. Nothing is evaluated while the graph is built; Optimize()
+// rewrites it and Evaluate() runs it. Subexpressions that only involve
+// constants are plain doubles and never touch a ciphertext.
+class ExpressionGraph {
+public:
+    using Node = uint32_t;
+
+    // The i-th call stands for inputs[i] of Evaluate() and Reference().
+    Node Input();
+    Node Constant(double value);
+    Node Add(Node a, Node b);
+    Node Mult(Node a, Node b);
+
+    // terms[0] + terms[1] + ..., or 0 for no terms.
+    Node Sum(const std::vector<Node>& terms);
+    // sum_k coefficients[k] * x^k, written out term by term; Optimize()
+    // shares the powers and drops the zero terms.
+    Node Polynomial(Node x, const std::vector<double>& coefficients);
+
+    // Marks a node as a result and returns its position in Evaluate()'s output.
+    size_t Output(Node node);
+
+    // Rewrites the graph in place, in order:
+    // - constant folding: constant subexpressions become one constant, x + 0
+    //   and x * 1 become x, and scalar factors and offsets on a chain merge;
+    // - zero-weight elimination: x * 0 becomes 0, so the term and any
+    //   subgraph only it used disappear;
+    // - common-subexpression elimination: identical operations on identical
+    //   operands, up to commutativity, become one node;
+    // - depth balancing: every chain of products is re-associated so the
+    //   shallowest factors are combined first, e.g. ((x * x) * x) * x becomes
+    //   (x * x) * (x * x). Scalar factors are applied last unless folding
+    //   them into the shallowest factor saves a level.
+    GraphStats Optimize();
+
+    size_t Inputs() const { return inputCount; }
+    size_t Outputs() const { return outputs.size(); }
+    // Homomorphic operations reachable from the outputs.
+    size_t Operations() const;
+    // Levels the deepest output consumes, for inputs at level 0.
+    uint32_t Depth() const;
+
+    // One ciphertext per Output(), in order. Intermediate ciphertexts are
+    // released as soon as their last consumer has run. With a pool, every
+    // operation is a task that starts once its operands exist, so independent
+    // operations run concurrently.
+    std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>> Evaluate(
+        const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+        const std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>>& inputs, ThreadPool* pool = nullptr) const;
+
+    // Plaintext counterpart of Evaluate(), used to compute expected results.
+    std::vector<double> Reference(const std::vector<double>& inputs) const;
+
+private:
+    enum class Kind { Input, Constant, Add, Mult };
+
+    struct NodeData {
+        Kind kind;
+        // Operands of Add and Mult, the index of an Input.
+        Node a = 0;
+        Node b = 0;
+        double value = 0.0;
+    };
+
+    class Builder;
+
+    Node Append(const NodeData& node);
+    void CheckNode(Node node) const;
+    std::vector<bool> Reachable() const;
+    // Depth of every node, and whether it is a plain constant expression.
+    void Analyze(std::vector<uint32_t>& depths, std::vector<bool>& plain) const;
+
+    std::vector<NodeData> nodes;
+    std::vector<Node> outputs;
+    uint32_t inputCount = 0;
+};
+
+}  // namespace fhe
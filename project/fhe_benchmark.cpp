@@ -0,0 +1,305 @@
+#include "openfhe.h"
+#include "kernels.h"
+#include "fixed_kernels.h"
+#include "batch_crypto.h"
+#include "keystore.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace lbcrypto;
+using namespace std;
+
+// Parameter sweep over the library kernels. Writes one CSV row per
+// (configuration, operation) with the mean and minimum wall time.
+//
+// Usage: fhe_benchmark [--sizes 2,4,8] [--batches 0] [--depths 3] [--scales 50]
+//                      [--ring-dims 0] [--threads 1] [--repetitions 3] [--output file.csv]
+// A batch of 0 picks the smallest power of two that fits a matrix row. A ring
+// dimension of 0 lets OpenFHE choose it for 128-bit security; any other value
+// disables the security check.
+
+struct Options {
+    vector<uint32_t> sizes = {2, 4, 8};
+    vector<uint32_t> batches = {0};
+    vector<uint32_t> depths = {3};
+    vector<uint32_t> scales = {50};
+    vector<uint32_t> ringDims = {0};
+    vector<uint32_t> threads = {1};
+    uint32_t repetitions = 3;
+    string output;
+};
+
+// One point of the sweep.
+struct Config {
+    uint32_t n;
+    uint32_t batchSize;
+    uint32_t depth;
+    uint32_t scale;
+    uint32_t ringDim;
+    uint32_t threads;
+};
+
+struct Timing {
+    double meanMs = 0.0;
+    double minMs = numeric_limits<double>::max();
+};
+
+vector<uint32_t> parseList(const string& text) {
+    vector<uint32_t> values;
+    stringstream stream(text);
+    string item;
+    while (getline(stream, item, ',')) {
+        values.push_back(stoul(item));
+    }
+    if (values.empty()) {
+        throw invalid_argument("empty list '" + text + "'");
+    }
+    return values;
+}
+
+Options parseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        string flag = argv[i];
+        if (i + 1 >= argc) {
+            throw invalid_argument("missing value for " + flag);
+        }
+        string value = argv[++i];
+        if (flag == "--sizes") {
+            options.sizes = parseList(value);
+        } else if (flag == "--batches") {
+            options.batches = parseList(value);
+        } else if (flag == "--depths") {
+            options.depths = parseList(value);
+        } else if (flag == "--scales") {
+            options.scales = parseList(value);
+        } else if (flag == "--threads") {
+            options.threads = parseList(value);
+        } else if (flag == "--repetitions") {
+            options.repetitions = max(1ul, stoul(value));
+        } else if (flag == "--ring-dims") {
+            options.ringDims = parseList(value);
+        } else if (flag == "--output") {
+            options.output = value;
+        } else {
+            throw invalid_argument("unknown option " + flag);
+        }
+    }
+    return options;
+}
+
+template <typename F>
+Timing measure(uint32_t repetitions, F&& f) {
+    Timing timing;
+    for (uint32_t r = 0; r < repetitions; r++) {
+        auto start = chrono::steady_clock::now();
+        f();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        timing.meanMs += ms / repetitions;
+        timing.minMs = min(timing.minMs, ms);
+    }
+    return timing;
+}
+
+uint32_t nextPowerOfTwo(uint32_t x) {
+    uint32_t p = 1;
+    while (p < x) {
+        p <<= 1;
+    }
+    return p;
+}
+
+vector<Config> sweep(const Options& options) {
+    vector<Config> configs;
+    for (uint32_t threads : options.threads) {
+        for (uint32_t n : options.sizes) {
+            for (uint32_t batch : options.batches) {
+                uint32_t batchSize = batch == 0 ? nextPowerOfTwo(n) : batch;
+                if (batchSize < n) {
+                    cerr << "skipping n=" << n << " batch=" << batchSize << ": a row does not fit" << endl;
+                    continue;
+                }
+                for (uint32_t depth : options.depths) {
+                    for (uint32_t scale : options.scales) {
+                        for (uint32_t ringDim : options.ringDims) {
+                            configs.push_back({n, batchSize, depth, scale, ringDim, threads});
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return configs;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options = parseOptions(argc, argv);
+
+        ofstream file;
+        if (!options.output.empty()) {
+            file.open(options.output);
+            if (!file) {
+                throw runtime_error("cannot open " + options.output);
+            }
+        }
+        ostream& out = options.output.empty() ? cout : file;
+        out << "n,batch_size,mult_depth,scale_mod_size,threads,ring_dim,operation,mean_ms,min_ms,repetitions" << endl;
+
+        // SiLU approximation used by the activation demo
+        const vector<double> silu = {0.0, 0.5, 0.25, 0.0, -1.0 / 48.0};
+        const uint32_t reps = options.repetitions;
+
+        for (const Config& config : sweep(options)) {
+#ifdef _OPENMP
+            omp_set_num_threads(config.threads);
+#endif
+            const uint32_t n = config.n;
+            CCParams<CryptoContextCKKSRNS> parameters;
+            parameters.SetMultiplicativeDepth(config.depth);
+            parameters.SetScalingModSize(config.scale);
+            parameters.SetBatchSize(config.batchSize);
+            if (config.ringDim != 0) {
+                parameters.SetSecurityLevel(HEStd_NotSet);
+                parameters.SetRingDim(config.ringDim);
+            }
+
+            CryptoContext<DCRTPoly> cc;
+            Timing context = measure(1, [&] {
+                cc = GenCryptoContext(parameters);
+                cc->Enable(PKE);
+                cc->Enable(KEYSWITCH);
+                cc->Enable(LEVELEDSHE);
+                cc->Enable(ADVANCEDSHE);
+            });
+            KeyPair<DCRTPoly> keys;
+            Timing keygen = measure(1, [&] {
+                keys = cc->KeyGen();
+                cc->EvalMultKeyGen(keys.secretKey);
+                cc->EvalSumKeyGen(keys.secretKey);
+            });
+            // The same keys for a second key pair, one task per key.
+            fhe::ThreadPool pool(config.threads);
+            Timing keygenParallel = measure(1, [&] {
+                KeyPair<DCRTPoly> parallelKeys = cc->KeyGen();
+                fhe::generateEvalKeys(cc, parallelKeys.secretKey, {{}, true}, &pool);
+            });
+
+            string prefix = to_string(n) + "," + to_string(config.batchSize) + "," + to_string(config.depth) + "," +
+                            to_string(config.scale) + "," + to_string(config.threads) + "," +
+                            to_string(cc->GetRingDimension()) + ",";
+            auto row = [&](const string& operation, const Timing& t, uint32_t r) {
+                out << prefix << operation << "," << t.meanMs << "," << t.minMs << "," << r << endl;
+            };
+            row("context", context, 1);
+            row("keygen", keygen, 1);
+            row("keygen_parallel", keygenParallel, 1);
+
+            fhe::PlainGrid A(n, vector<double>(n));
+            for (uint32_t i = 0; i < n; i++) {
+                for (uint32_t j = 0; j < n; j++) {
+                    A[i][j] = 1.0 / (1 + i + j);
+                }
+            }
+
+            Plaintext ptx;
+            row("encode", measure(reps, [&] { ptx = cc->MakeCKKSPackedPlaintext(A[0]); }), reps);
+            Ciphertext<DCRTPoly> ct;
+            row("encrypt", measure(reps, [&] { ct = cc->Encrypt(keys.publicKey, ptx); }), reps);
+
+            // Whole n x n grid, one ciphertext per element: serial, then on a pool.
+            row("encrypt_grid", measure(reps, [&] { fhe::encryptGrid(cc, keys.publicKey, A); }), reps);
+            fhe::BatchEncryptor encryptor(cc, keys.publicKey, pool);
+            row("encrypt_grid_parallel", measure(reps, [&] { encryptor.EncryptGrid(A); }), reps);
+
+            // matmul and conv need one level, the activation polynomialDepth(silu).
+            auto encryptedA = fhe::EncryptedMatrix::Encrypt(cc, keys.publicKey, A, fhe::Packing::Rows);
+            auto encryptedB = fhe::EncryptedMatrix::Encrypt(cc, keys.publicKey, A, fhe::Packing::Columns);
+            row("matmul", measure(reps, [&] { fhe::matMul(cc, encryptedA, encryptedB); }), reps);
+            row("matmul_parallel",
+                measure(reps, [&] { fhe::matMul(cc, encryptedA, encryptedB, fhe::Accumulation::Lazy, &pool); }),
+                reps);
+
+            // One ciphertext per element: n products per entry, relinearized each or once.
+            auto elementA = encryptor.Encrypt(A, fhe::Packing::Element);
+            row("matmul_element_eager",
+                measure(reps, [&] { fhe::matMul(cc, elementA, elementA, fhe::Accumulation::Eager); }), reps);
+            row("matmul_element_lazy",
+                measure(reps, [&] { fhe::matMul(cc, elementA, elementA, fhe::Accumulation::Lazy); }), reps);
+
+            const size_t kernelSize = n >= 3 ? 3 : 2;
+            if (n >= kernelSize) {
+                fhe::PlainGrid kernel(kernelSize, vector<double>(kernelSize, 0.5));
+                fhe::CiphertextGrid image = fhe::encryptGrid(cc, keys.publicKey, A);
+                row("conv", measure(reps, [&] { fhe::conv2d(cc, image, kernel, 0.0); }), reps);
+                row("conv_parallel", measure(reps, [&] { fhe::conv2d(cc, image, kernel, 0.0, &pool); }), reps);
+                if (kernelSize == 3) {
+                    fhe::FixedConv2D<3> fixed({{{0.5, 0.5, 0.5}, {0.5, 0.5, 0.5}, {0.5, 0.5, 0.5}}});
+                    row("conv_fixed", measure(reps, [&] { fixed.Apply(cc, image); }), reps);
+                } else {
+                    fhe::FixedConv2D<2> fixed({{{0.5, 0.5}, {0.5, 0.5}}});
+                    row("conv_fixed", measure(reps, [&] { fixed.Apply(cc, image); }), reps);
+                }
+            }
+
+            // Diagonal matrix-vector product, planned per call or at compile time
+            // when n is one of the fixed sizes and the batch is its window.
+            auto matVecRows = [&](auto size) {
+                constexpr uint32_t N = decltype(size)::value;
+                if (n != N || config.batchSize != fhe::fixedWindow(N)) {
+                    return;
+                }
+                cc->EvalRotateKeyGen(keys.secretKey, fhe::FixedMatVec<N>::Rotations());
+                fhe::FixedMatrix<N> weights;
+                for (uint32_t i = 0; i < N; i++) {
+                    for (uint32_t j = 0; j < N; j++) {
+                        weights[i][j] = A[i][j];
+                    }
+                }
+                row("matvec", measure(reps, [&] { fhe::matVecDiagonal(cc, ct, A); }), reps);
+                fhe::FixedMatVec<N> fixed(cc, weights);
+                row("matvec_fixed", measure(reps, [&] { fixed.Apply(ct); }), reps);
+            };
+            matVecRows(integral_constant<uint32_t, 2>{});
+            matVecRows(integral_constant<uint32_t, 3>{});
+            matVecRows(integral_constant<uint32_t, 4>{});
+            matVecRows(integral_constant<uint32_t, 8>{});
+            matVecRows(integral_constant<uint32_t, 16>{});
+
+            if (config.depth >= fhe::polynomialDepth(silu)) {
+                row("activation", measure(reps, [&] { fhe::evalPolynomial(cc, ct, silu); }), reps);
+            }
+
+            Plaintext result;
+            row("decrypt", measure(reps, [&] { cc->Decrypt(keys.secretKey, ct, &result); }), reps);
+
+            fhe::CiphertextGrid grid = encryptor.EncryptGrid(A);
+            row("decrypt_grid", measure(reps, [&] { fhe::decryptGrid(cc, keys.secretKey, grid); }), reps);
+            fhe::BatchDecryptor decryptor(cc, keys.secretKey, pool);
+            row("decrypt_grid_parallel", measure(reps, [&] { decryptor.DecryptGrid(grid); }), reps);
+
+            // OpenFHE keeps every context and its keys in process-wide maps; drop
+            // them so a long sweep does not hold all configurations at once.
+            CryptoContextImpl<DCRTPoly>::ClearEvalMultKeys();
+            CryptoContextImpl<DCRTPoly>::ClearEvalAutomorphismKeys();
+            CryptoContextFactory<DCRTPoly>::ReleaseAllContexts();
+        }
+
+    } catch (const exception& e) {
+        cerr << "Exception: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include "openfhe.h"
+#include "batch_crypto.h"
+#include "ciphertext_file.h"
+#include "keystore.h"
+#include "model.h"
+#include "remote.h"
+#include "tuning.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <random>
+#include <string>
+#include <thread>
+
+using namespace lbcrypto;
+using namespace std;
+
+// Client for fhe_server. It owns the secret key: it generates the context and
+// keys, sends only the evaluation keys, and streams encrypted images one row
+// per chunk. It decrypts the outputs as they come back. Sending and
+// receiving run concurrently, so transfer overlaps with evaluation.
+// Usage: fhe_client [socket path] [model file] [number of images] [key store directory]
+
+const double acceptable_error = 1e-2;
+
+double elapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        string socketPath = argc > 1 ? argv[1] : "/tmp/fhe_server.sock";
+        string modelPath = argc > 2 ? argv[2] : "models/small_cnn.txt";
+        uint32_t numImages = argc > 3 ? stoul(argv[3]) : 4;
+        string keyStorePath = argc > 4 ? argv[4] : "";
+
+        fhe::Model model = fhe::loadModel(modelPath);
+        const fhe::Pipeline& pipeline = model.pipeline;
+        if (pipeline.BootstrappingEnabled()) {
+            throw runtime_error("fhe_server does not support bootstrapped models");
+        }
+
+        // keygen, sized for the whole network
+        uint32_t batchSize = model.BatchSize();
+        auto setupStart = chrono::steady_clock::now();
+        fhe::ParameterChoice choice = fhe::chooseParameters(fhe::planPipeline(
+            pipeline, model.InputShape(), model.inputRange, batchSize, -log2(acceptable_error) + 10));
+        vector<int32_t> rotations = pipeline.RotationIndices(batchSize, model.InputShape());
+        CryptoContext<DCRTPoly> cc;
+        KeyPair<DCRTPoly> keys;
+        if (!keyStorePath.empty()) {
+            fhe::KeyMaterial material = fhe::KeyStore(keyStorePath).Open(choice.Parameters(), {rotations, false});
+            cc = material.cc;
+            keys = material.keys;
+        } else {
+            cc = GenCryptoContext(choice.Parameters());
+            cc->Enable(PKE);
+            cc->Enable(KEYSWITCH);
+            cc->Enable(LEVELEDSHE);
+            keys = cc->KeyGen();
+            cc->EvalMultKeyGen(keys.secretKey);
+            if (!rotations.empty()) {
+                cc->EvalRotateKeyGen(keys.secretKey, rotations);
+            }
+        }
+        cout << "Ring dimension: " << cc->GetRingDimension() << " | setup: " << elapsedMs(setupStart) << " ms"
+             << endl;
+
+        auto connection = fhe::connectTo(socketPath);
+        auto start = chrono::steady_clock::now();
+        fhe::sendEvalContext(connection->Out(), cc, keys.secretKey->GetKeyTag(), !rotations.empty());
+        cout << "Sent context and eval keys: " << elapsedMs(start) << " ms" << endl;
+
+        mt19937 rng(42);
+        uniform_real_distribution<double> pixel(model.inputRange.lo, model.inputRange.hi);
+        vector<fhe::PlainGrid> images(numImages, fhe::PlainGrid(model.inputRows, vector<double>(model.inputCols)));
+        for (auto& X : images) {
+            for (auto& row : X) {
+                for (auto& x : row) {
+                    x = pixel(rng);
+                }
+            }
+        }
+
+        fhe::ThreadPool pool;
+        fhe::BatchEncryptor encryptor(cc, keys.publicKey, pool);
+        fhe::BatchDecryptor decryptor(cc, keys.secretKey, pool);
+        start = chrono::steady_clock::now();
+        exception_ptr sendError;
+        thread sender([&] {
+            try {
+                for (const auto& X : images) {
+                    fhe::EncryptedMatrix encryptedX = encryptor.Encrypt(X, fhe::Packing::Element);
+                    fhe::CiphertextWriter writer(connection->Out(), fhe::Packing::Element, model.inputRows,
+                                                 model.inputCols, model.inputCols);
+                    for (const auto& ct : encryptedX.Ciphertexts()) {
+                        writer.Append(ct);
+                    }
+                    writer.Finish();
+                }
+            } catch (...) {
+                sendError = current_exception();
+            }
+            connection->CloseWrite();
+        });
+
+        double maxError = 0.0;
+        uint32_t agreements = 0;
+        uint32_t received = 0;
+        try {
+            for (const auto& X : images) {
+                fhe::CiphertextStreamReader reader(connection->In());
+                vector<Ciphertext<DCRTPoly>> output;
+                vector<Ciphertext<DCRTPoly>> chunk;
+                while (reader.Next(chunk)) {
+                    output.insert(output.end(), chunk.begin(), chunk.end());
+                }
+
+                // The last stage is a dense layer, packed in a single ciphertext.
+                vector<double> expected = pipeline.Reference(X).back()[0];
+                vector<double> logits = decryptor.DecryptPrefix({output.at(0)}, expected.size());
+                for (size_t j = 0; j < expected.size(); j++) {
+                    maxError = max(maxError, abs(logits[j] - expected[j]));
+                }
+                if (max_element(logits.begin(), logits.end()) - logits.begin() ==
+                    max_element(expected.begin(), expected.end()) - expected.begin()) {
+                    agreements++;
+                }
+                received++;
+            }
+        } catch (...) {
+            sender.join();
+            throw;
+        }
+        sender.join();
+        if (sendError) {
+            rethrow_exception(sendError);
+        }
+        double totalMs = elapsedMs(start);
+
+        cout << "Round trip for " << received << " images: " << totalMs << " ms ("
+             << received / (totalMs / 1000.0) << " images/s)" << endl;
+        cout << "Max logit error vs plaintext model: " << maxError << " | argmax agreement: " << agreements << "/"
+             << numImages << endl;
+
+        if (maxError <= acceptable_error && agreements == numImages) {
+            cout << "\nRemote Inference Completed successfully." << endl;
+            cout << "Whoopee! Bad guys won't be able to steal my precious numbers 😊" << endl;
+        } else {
+            cout << "\nRemote Inference failing to get expected result. This can be due to unsufficient accuracy or wrong calculations" << endl;
+            cout << "🥺😢" << endl;
+        }
+
+    } catch (const exception& e) {
+        cerr << "Exception: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,466 @@
+#include "openfhe.h"
+#include "pipeline.h"
+#include "kernels.h"
+#include "batch_crypto.h"
+#include "expression_graph.h"
+#include <functional>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace lbcrypto;
+using namespace std;
+
+// Randomized correctness and performance regression run over every encrypted
+// kernel. Inputs are random matrices, images and kernels of the requested
+// sizes; every result is decrypted and compared with a plaintext reference.
+// Writes one CSV row per (size, kernel) with the max and mean absolute error
+// and the mean and minimum wall time, and exits with 1 if any kernel exceeds
+// its tolerance. The BFV rows must be exact.
+//
+// The rotation_keys rows check that the keys a layer or pipeline declares are
+// exactly the ones its Forward() rotates by: it must run with only those keys
+// and fail without any one of them. Their error column counts the mismatches.
+//
+// Usage: fhe_regression [--sizes 4,16,64] [--kernels 3,5] [--element-max 16] [--seed 1]
+//                       [--repetitions 3] [--tolerance 1e-4] [--threads 0] [--output file.csv]
+// The Element-packed matrix products take n^3 ciphertext products and only run
+// up to --element-max.
+
+struct Options {
+    vector<uint32_t> sizes = {4, 16, 64};
+    vector<uint32_t> kernels = {3, 5};
+    uint32_t elementMax = 16;
+    uint32_t seed = 1;
+    uint32_t repetitions = 3;
+    double tolerance = 1e-4;
+    // Pool workers; 0 means one per hardware thread.
+    uint32_t threads = 0;
+    string output;
+};
+
+struct Timing {
+    double meanMs = 0.0;
+    double minMs = numeric_limits<double>::max();
+};
+
+struct ErrorStats {
+    double maxError = 0.0;
+    double meanError = 0.0;
+};
+
+vector<uint32_t> parseList(const string& text) {
+    vector<uint32_t> values;
+    stringstream stream(text);
+    string item;
+    while (getline(stream, item, ',')) {
+        values.push_back(stoul(item));
+    }
+    if (values.empty()) {
+        throw invalid_argument("empty list '" + text + "'");
+    }
+    return values;
+}
+
+Options parseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        string flag = argv[i];
+        if (i + 1 >= argc) {
+            throw invalid_argument("missing value for " + flag);
+        }
+        string value = argv[++i];
+        if (flag == "--sizes") {
+            options.sizes = parseList(value);
+        } else if (flag == "--kernels") {
+            options.kernels = parseList(value);
+        } else if (flag == "--element-max") {
+            options.elementMax = stoul(value);
+        } else if (flag == "--seed") {
+            options.seed = stoul(value);
+        } else if (flag == "--repetitions") {
+            options.repetitions = max(1ul, stoul(value));
+        } else if (flag == "--tolerance") {
+            options.tolerance = stod(value);
+        } else if (flag == "--threads") {
+            options.threads = stoul(value);
+        } else if (flag == "--output") {
+            options.output = value;
+        } else {
+            throw invalid_argument("unknown option " + flag);
+        }
+    }
+    return options;
+}
+
+template <typename F>
+Timing measure(uint32_t repetitions, F&& f) {
+    Timing timing;
+    for (uint32_t r = 0; r < repetitions; r++) {
+        auto start = chrono::steady_clock::now();
+        f();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        timing.meanMs += ms / repetitions;
+        timing.minMs = min(timing.minMs, ms);
+    }
+    return timing;
+}
+
+uint32_t nextPowerOfTwo(uint32_t x) {
+    uint32_t p = 1;
+    while (p < x) {
+        p <<= 1;
+    }
+    return p;
+}
+
+template <typename T>
+ErrorStats compare(const vector<vector<T>>& actual, const vector<vector<T>>& expected) {
+    ErrorStats stats;
+    size_t count = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        for (size_t j = 0; j < expected[i].size(); j++) {
+            double error = abs(static_cast<double>(actual[i][j]) - static_cast<double>(expected[i][j]));
+            stats.maxError = max(stats.maxError, error);
+            stats.meanError += error;
+            count++;
+        }
+    }
+    stats.meanError /= max<size_t>(count, 1);
+    return stats;
+}
+
+// Plaintext references
+
+template <typename T>
+vector<vector<T>> multiply(const vector<vector<T>>& a, const vector<vector<T>>& b) {
+    vector<vector<T>> c(a.size(), vector<T>(b[0].size(), 0));
+    for (size_t i = 0; i < a.size(); i++) {
+        for (size_t j = 0; j < b[0].size(); j++) {
+            for (size_t k = 0; k < b.size(); k++) {
+                c[i][j] += a[i][k] * b[k][j];
+            }
+        }
+    }
+    return c;
+}
+
+template <typename T>
+vector<vector<T>> convolve(const vector<vector<T>>& x, const vector<vector<T>>& kernel, T bias) {
+    const size_t outRows = x.size() - kernel.size() + 1;
+    const size_t outCols = x[0].size() - kernel[0].size() + 1;
+    vector<vector<T>> y(outRows, vector<T>(outCols, bias));
+    for (size_t i = 0; i < outRows; i++) {
+        for (size_t j = 0; j < outCols; j++) {
+            for (size_t m = 0; m < kernel.size(); m++) {
+                for (size_t n = 0; n < kernel[0].size(); n++) {
+                    y[i][j] += x[i + m][j + n] * kernel[m][n];
+                }
+            }
+        }
+    }
+    return y;
+}
+
+fhe::PlainGrid pool2d(const fhe::PlainGrid& x, uint32_t size, double scale, double shift) {
+    fhe::PlainGrid y(x.size() / size, vector<double>(x[0].size() / size, 0.0));
+    for (size_t i = 0; i < y.size(); i++) {
+        for (size_t j = 0; j < y[0].size(); j++) {
+            for (uint32_t m = 0; m < size; m++) {
+                for (uint32_t n = 0; n < size; n++) {
+                    y[i][j] += x[i * size + m][j * size + n];
+                }
+            }
+            y[i][j] = y[i][j] * scale + shift;
+        }
+    }
+    return y;
+}
+
+double polynomial(const vector<double>& coefficients, double x) {
+    double y = 0.0;
+    for (size_t k = coefficients.size(); k-- > 0;) {
+        y = y * x + coefficients[k];
+    }
+    return y;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options = parseOptions(argc, argv);
+
+        ofstream file;
+        if (!options.output.empty()) {
+            file.open(options.output);
+            if (!file) {
+                throw runtime_error("cannot open " + options.output);
+            }
+        }
+        ostream& out = options.output.empty() ? cout : file;
+        out << "scheme,n,batch_size,ring_dim,kernel,max_error,mean_error,tolerance,mean_ms,min_ms,repetitions,status"
+            << endl;
+
+        // SiLU approximation used by the activation demo
+        const vector<double> silu = {0.0, 0.5, 0.25, 0.0, -1.0 / 48.0};
+        const uint32_t reps = options.repetitions;
+        const uint32_t scaleModSize = 50;
+        const uint64_t plaintextModulus = 65537;
+        mt19937 rng(options.seed);
+        uniform_real_distribution<double> real(-1.0, 1.0);
+        uniform_int_distribution<int64_t> integer(-9, 9);
+        auto randomGrid = [&](size_t rows, size_t cols) {
+            fhe::PlainGrid grid(rows, vector<double>(cols));
+            for (auto& row : grid) {
+                generate(row.begin(), row.end(), [&] { return real(rng); });
+            }
+            return grid;
+        };
+        auto randomIntGrid = [&](size_t rows, size_t cols) {
+            fhe::IntGrid grid(rows, vector<int64_t>(cols));
+            for (auto& row : grid) {
+                generate(row.begin(), row.end(), [&] { return integer(rng); });
+            }
+            return grid;
+        };
+
+        fhe::ThreadPool pool(options.threads);
+        size_t failures = 0;
+
+        for (uint32_t n : options.sizes) {
+            const uint32_t batchSize = nextPowerOfTwo(n);
+
+            // A random graph: a polynomial of one input plus a product with a second.
+            fhe::ExpressionGraph graph;
+            fhe::ExpressionGraph::Node x0 = graph.Input();
+            fhe::ExpressionGraph::Node x1 = graph.Input();
+            fhe::ExpressionGraph::Node product = graph.Mult(graph.Mult(x0, x1), graph.Constant(real(rng)));
+            graph.Output(graph.Add(graph.Polynomial(x0, silu), product));
+            graph.Optimize();
+
+            // Deepest CKKS kernel: the activation polynomial or the graph.
+            const uint32_t multDepth = max({1u, fhe::polynomialDepth(silu), graph.Depth()});
+            CryptoContext<DCRTPoly> cc = GenCryptoContext(fhe::makeParameters(multDepth, scaleModSize, batchSize));
+            cc->Enable(PKE);
+            cc->Enable(KEYSWITCH);
+            cc->Enable(LEVELEDSHE);
+            cc->Enable(ADVANCEDSHE);
+
+            fhe::PlainGrid A = randomGrid(n, n);
+            fhe::PlainGrid B = randomGrid(n, n);
+            fhe::PlainGrid W = randomGrid(n, n);
+
+            KeyPair<DCRTPoly> keys = cc->KeyGen();
+            cc->EvalMultKeyGen(keys.secretKey);
+            cc->EvalSumKeyGen(keys.secretKey);
+            vector<int32_t> rotations;
+            for (const auto& diagonal : fhe::cyclicDiagonals(W, batchSize)) {
+                if (diagonal.first != 0) {
+                    rotations.push_back(diagonal.first);
+                }
+            }
+            cc->EvalRotateKeyGen(keys.secretKey, rotations);
+
+            fhe::BatchEncryptor encryptor(cc, keys.publicKey, pool);
+            fhe::BatchDecryptor decryptor(cc, keys.secretKey, pool);
+
+            string prefix = to_string(n) + "," + to_string(batchSize) + "," + to_string(cc->GetRingDimension()) + ",";
+            auto record = [&](const string& scheme, const string& kernel, const Timing& t, const ErrorStats& e,
+                              double tolerance) {
+                const bool pass = e.maxError <= tolerance;
+                failures += pass ? 0 : 1;
+                out << scheme << "," << prefix << kernel << "," << e.maxError << "," << e.meanError << ","
+                    << tolerance << "," << t.meanMs << "," << t.minMs << "," << reps << "," << (pass ? "pass" : "FAIL")
+                    << endl;
+            };
+            auto ckks = [&](const string& kernel, const Timing& t, const fhe::PlainGrid& actual,
+                            const fhe::PlainGrid& expected) {
+                record("ckks", kernel, t, compare(actual, expected), options.tolerance);
+            };
+
+            // Matrix products in both supported packings
+            const fhe::PlainGrid AB = multiply(A, B);
+            fhe::EncryptedMatrix rowsA = encryptor.Encrypt(A, fhe::Packing::Rows);
+            fhe::EncryptedMatrix columnsB = encryptor.Encrypt(B, fhe::Packing::Columns);
+            fhe::EncryptedMatrix C;
+            Timing t = measure(reps, [&] { C = fhe::matMul(cc, rowsA, columnsB); });
+            ckks("matmul", t, decryptor.Decrypt(C), AB);
+            t = measure(reps, [&] { C = fhe::matMul(cc, rowsA, columnsB, fhe::Accumulation::Lazy, &pool); });
+            ckks("matmul_parallel", t, decryptor.Decrypt(C), AB);
+
+            fhe::EncryptedMatrix elementA = encryptor.Encrypt(A, fhe::Packing::Element);
+            if (n <= options.elementMax) {
+                fhe::EncryptedMatrix elementB = encryptor.Encrypt(B, fhe::Packing::Element);
+                t = measure(reps, [&] { C = fhe::matMul(cc, elementA, elementB, fhe::Accumulation::Eager, &pool); });
+                ckks("matmul_element_eager", t, decryptor.Decrypt(C), AB);
+                t = measure(reps, [&] { C = fhe::matMul(cc, elementA, elementB, fhe::Accumulation::Lazy, &pool); });
+                ckks("matmul_element_lazy", t, decryptor.Decrypt(C), AB);
+            }
+
+            // Convolutions of the image A, one row per kernel size that fits
+            fhe::CiphertextGrid image = elementA.ToGrid();
+            for (uint32_t k : options.kernels) {
+                if (k > n) {
+                    continue;
+                }
+                fhe::PlainGrid kernel = randomGrid(k, k);
+                const double bias = real(rng);
+                fhe::CiphertextGrid Y;
+                t = measure(reps, [&] { Y = fhe::conv2d(cc, image, kernel, bias, &pool); });
+                ckks("conv" + to_string(k) + "x" + to_string(k), t, decryptor.DecryptGrid(Y),
+                     convolve(A, kernel, bias));
+            }
+
+            if (n >= 2) {
+                fhe::CiphertextGrid Y;
+                t = measure(reps, [&] { Y = fhe::avgPool2d(cc, image, 2, 0.25, 0.5); });
+                ckks("avgpool2x2", t, decryptor.DecryptGrid(Y), pool2d(A, 2, 0.25, 0.5));
+            }
+
+            // Matrix-vector products: x packed in one ciphertext, or one ciphertext per entry
+            const fhe::PlainGrid x = {A[0]};
+            fhe::PlainGrid Wx(1, vector<double>(n, 0.0));
+            for (uint32_t j = 0; j < n; j++) {
+                for (uint32_t k = 0; k < n; k++) {
+                    Wx[0][j] += W[j][k] * x[0][k];
+                }
+            }
+            Ciphertext<DCRTPoly> packedX = encryptor.Encrypt(x, fhe::Packing::Rows).At(0);
+            Ciphertext<DCRTPoly> y;
+            t = measure(reps, [&] { y = fhe::matVecDiagonal(cc, packedX, W); });
+            ckks("matvec_diagonal", t, {decryptor.DecryptPrefix({y}, n)}, Wx);
+            vector<Ciphertext<DCRTPoly>> elementX(image[0].begin(), image[0].end());
+            t = measure(reps, [&] { y = fhe::matVecColumns(cc, elementX, W); });
+            ckks("matvec_columns", t, {decryptor.DecryptPrefix({y}, n)}, Wx);
+
+            // Declared rotation keys against the ones Forward() uses, with x packed,
+            // with one ciphertext per entry, and through a whole conv, pool, dense pipeline.
+            auto checkRotationKeys = [&](const string& kernel, const vector<int32_t>& declared,
+                                         const function<void()>& forward) {
+                auto& keyMap = CryptoContextImpl<DCRTPoly>::GetEvalAutomorphismKeyMap(keys.secretKey->GetKeyTag());
+                const map<uint32_t, EvalKey<DCRTPoly>> saved = keyMap;
+                keyMap.clear();
+                size_t mismatches = 0;
+                for (int32_t r : declared) {
+                    const uint32_t index = cc->FindAutomorphismIndex(r);
+                    auto key = saved.find(index);
+                    if (key == saved.end()) {
+                        throw runtime_error(kernel + ": no key generated for rotation " + to_string(r));
+                    }
+                    keyMap.insert(*key);
+                }
+                Timing t;
+                try {
+                    t = measure(1, forward);
+                } catch (const exception&) {
+                    mismatches++;  // a rotation that was not declared
+                }
+                for (int32_t r : declared) {
+                    const uint32_t index = cc->FindAutomorphismIndex(r);
+                    auto key = keyMap.extract(index);
+                    try {
+                        forward();
+                        mismatches++;  // declared but never used
+                    } catch (const exception&) {
+                    }
+                    keyMap.insert(move(key));
+                }
+                keyMap = saved;
+                record("ckks", "rotation_keys_" + kernel, t, {static_cast<double>(mismatches), 0.0}, 0.0);
+            };
+            fhe::DenseLayer dense(W, {});
+            checkRotationKeys("dense_packed", dense.RotationIndices(batchSize, {1, 1}),
+                              [&] { dense.Forward(cc, {{packedX}}); });
+            checkRotationKeys("dense_columns", dense.RotationIndices(batchSize, {1, n}),
+                              [&] { dense.Forward(cc, {image[0]}); });
+            const uint32_t convSize = options.kernels[0];
+            if (n <= options.elementMax && convSize <= n && (n - convSize + 1) / 2 > 0) {
+                const size_t pooled = (n - convSize + 1) / 2;
+                fhe::Pipeline network;
+                network.Add(make_shared<fhe::Conv2DLayer>(randomGrid(convSize, convSize), real(rng)))
+                    .Add(make_shared<fhe::AvgPool2DLayer>(2))
+                    .Add(make_shared<fhe::DenseLayer>(randomGrid(n, pooled * pooled), vector<double>()));
+                if (network.Depth() <= multDepth) {
+                    // A 1x1 pooled output reaches the dense layer as if packed and needs its diagonals.
+                    const vector<int32_t> declared = network.RotationIndices(batchSize, {n, n});
+                    if (!declared.empty()) {
+                        cc->EvalRotateKeyGen(keys.secretKey, declared);
+                    }
+                    checkRotationKeys("pipeline", declared, [&] { network.Run(cc, image); });
+                }
+            }
+
+            // Slot-wise activation and graph on packed rows of A and B
+            fhe::PlainGrid activation(1, vector<double>(n));
+            fhe::PlainGrid graphExpected(1, vector<double>(n));
+            for (uint32_t i = 0; i < n; i++) {
+                activation[0][i] = polynomial(silu, A[0][i]);
+                graphExpected[0][i] = graph.Reference({A[0][i], B[0][i]})[0];
+            }
+            t = measure(reps, [&] { y = fhe::evalPolynomial(cc, packedX, silu); });
+            ckks("activation", t, {decryptor.DecryptPrefix({y}, n)}, activation);
+            vector<Ciphertext<DCRTPoly>> graphInputs = {packedX, encryptor.Encrypt({B[0]}, fhe::Packing::Rows).At(0)};
+            vector<Ciphertext<DCRTPoly>> graphOutputs;
+            t = measure(reps, [&] { graphOutputs = graph.Evaluate(cc, graphInputs, &pool); });
+            ckks("graph", t, {decryptor.DecryptPrefix(graphOutputs, n)}, graphExpected);
+
+            // The exact BFV paths, on integers small enough that no result wraps mod t
+            CryptoContext<DCRTPoly> bfv =
+                GenCryptoContext(fhe::makeIntegerParameters<CryptoContextBFVRNS>(1, plaintextModulus, batchSize));
+            bfv->Enable(PKE);
+            bfv->Enable(KEYSWITCH);
+            bfv->Enable(LEVELEDSHE);
+            bfv->Enable(ADVANCEDSHE);
+            KeyPair<DCRTPoly> bfvKeys = bfv->KeyGen();
+            bfv->EvalMultKeyGen(bfvKeys.secretKey);
+            bfv->EvalSumKeyGen(bfvKeys.secretKey);
+            fhe::BatchEncryptor bfvEncryptor(bfv, bfvKeys.publicKey, pool);
+            fhe::BatchDecryptor bfvDecryptor(bfv, bfvKeys.secretKey, pool);
+            prefix = to_string(n) + "," + to_string(batchSize) + "," + to_string(bfv->GetRingDimension()) + ",";
+
+            fhe::IntGrid intA = randomIntGrid(n, n);
+            fhe::IntGrid intB = randomIntGrid(n, n);
+            fhe::EncryptedMatrix rowsIntA = bfvEncryptor.EncryptIntegers(intA, fhe::Packing::Rows);
+            fhe::EncryptedMatrix columnsIntB = bfvEncryptor.EncryptIntegers(intB, fhe::Packing::Columns);
+            t = measure(reps, [&] {
+                C = fhe::matMul(bfv, rowsIntA, columnsIntB, fhe::maxMagnitude(intA), fhe::maxMagnitude(intB),
+                                fhe::Accumulation::Lazy, &pool);
+            });
+            record("bfv", "matmul", t, compare(bfvDecryptor.DecryptIntegers(C), multiply(intA, intB)), 0.0);
+
+            fhe::CiphertextGrid intImage = bfvEncryptor.EncryptIntegers(intA, fhe::Packing::Element).ToGrid();
+            for (uint32_t k : options.kernels) {
+                if (k > n) {
+                    continue;
+                }
+                fhe::IntGrid kernel = randomIntGrid(k, k);
+                const int64_t bias = integer(rng);
+                fhe::CiphertextGrid Y;
+                t = measure(reps,
+                            [&] { Y = fhe::conv2d(bfv, intImage, kernel, bias, fhe::maxMagnitude(intA), &pool); });
+                record("bfv", "conv" + to_string(k) + "x" + to_string(k), t,
+                       compare(bfvDecryptor.DecryptIntegers(fhe::EncryptedMatrix::FromGrid(Y)),
+                               convolve(intA, kernel, bias)),
+                       0.0);
+            }
+        }
+
+        if (failures > 0) {
+            cerr << failures << " kernel(s) exceeded their tolerance" << endl;
+            return 1;
+        }
+
+    } catch (const exception& e) {
+        cerr << "Exception: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "openfhe.h"
+#include "blocking_queue.h"
+#include "ciphertext_file.h"
+#include "model.h"
+#include "remote.h"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <exception>
+#include <string>
+#include <thread>
+
+using namespace lbcrypto;
+using namespace std;
+
+// Evaluation server for fhe_client. Receives a context with its
+// relinearization and rotation keys, then a stream of encrypted images. It
+// runs the model on each image and streams the outputs back. It never sees
+// a secret key.
+// Usage: fhe_server [socket path] [model file] [connections to serve, 0 = unlimited]
+
+double elapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Drops what receiveEvalContext() loaded into OpenFHE's process-wide key
+// maps and context cache, so memory does not grow with every client.
+void releaseEvalContext(const string& keyTag) {
+    CryptoContextImpl<DCRTPoly>::ClearEvalMultKeys(keyTag);
+    CryptoContextImpl<DCRTPoly>::ClearEvalAutomorphismKeys(keyTag);
+    CryptoContextFactory<DCRTPoly>::ReleaseAllContexts();
+}
+
+void evaluate(fhe::Connection& connection, const fhe::Pipeline& pipeline, const CryptoContext<DCRTPoly>& cc) {
+    // Images are received and deserialized chunk by chunk on their own thread,
+    // so the next image arrives while the current one is evaluated.
+    fhe::BlockingQueue<fhe::EncryptedMatrix> inputs;
+    exception_ptr receiveError;
+    thread receiver([&] {
+        try {
+            while (connection.In().peek() != EOF) {
+                fhe::CiphertextStreamReader reader(connection.In());
+                const fhe::CiphertextFileHeader& header = reader.Header();
+                vector<Ciphertext<DCRTPoly>> ciphertexts;
+                vector<Ciphertext<DCRTPoly>> chunk;
+                while (reader.Next(chunk)) {
+                    ciphertexts.insert(ciphertexts.end(), chunk.begin(), chunk.end());
+                }
+                inputs.Push(fhe::EncryptedMatrix(header.packing, header.rows, header.cols, move(ciphertexts)));
+            }
+        } catch (...) {
+            receiveError = current_exception();
+        }
+        inputs.Close();
+    });
+
+    uint32_t image = 0;
+    try {
+        while (auto input = inputs.Pop()) {
+            auto evaluateStart = chrono::steady_clock::now();
+            fhe::EncryptedMatrix output = fhe::EncryptedMatrix::FromGrid(pipeline.Run(cc, input->ToGrid()).back());
+            double evaluateMs = elapsedMs(evaluateStart);
+
+            fhe::CiphertextWriter writer(connection.Out(), output.GetPacking(), output.Rows(), output.Cols());
+            for (const auto& ct : output.Ciphertexts()) {
+                writer.Append(ct);
+            }
+            writer.Finish();
+            cout << "Image " << image++ << ": evaluated in " << evaluateMs << " ms" << endl;
+        }
+    } catch (...) {
+        // Wake the receiver out of recv() and wait for it before unwinding.
+        connection.Shutdown();
+        inputs.Close();
+        receiver.join();
+        throw;
+    }
+    receiver.join();
+    connection.CloseWrite();
+    if (receiveError) {
+        rethrow_exception(receiveError);
+    }
+}
+
+void serve(fhe::Connection& connection, const fhe::Pipeline& pipeline) {
+    string keyTag;
+    try {
+        auto start = chrono::steady_clock::now();
+        CryptoContext<DCRTPoly> cc = fhe::receiveEvalContext(connection.In(), &keyTag);
+        cout << "Received context and eval keys: " << elapsedMs(start) << " ms" << endl;
+        evaluate(connection, pipeline, cc);
+    } catch (...) {
+        releaseEvalContext(keyTag);
+        throw;
+    }
+    releaseEvalContext(keyTag);
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        string socketPath = argc > 1 ? argv[1] : "/tmp/fhe_server.sock";
+        string modelPath = argc > 2 ? argv[2] : "models/small_cnn.txt";
+        uint32_t connections = argc > 3 ? stoul(argv[3]) : 1;
+
+        fhe::Model model = fhe::loadModel(modelPath);
+        if (model.pipeline.BootstrappingEnabled()) {
+            throw runtime_error("bootstrapping keys are not transferred; serve a model without bootstrapping");
+        }
+
+        fhe::Listener listener(socketPath);
+        cout << "Serving " << modelPath << " on " << socketPath << endl;
+        for (uint32_t served = 0; connections == 0 || served < connections; served++) {
+            auto connection = listener.Accept();
+            // A failing client ends its own connection, not the server.
+            try {
+                serve(*connection, model.pipeline);
+            } catch (const exception& e) {
+                cerr << "Connection " << served << " failed: " << e.what() << endl;
+            }
+        }
+
+    } catch (const exception& e) {
+        cerr << "Exception: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
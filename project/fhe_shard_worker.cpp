@@ -0,0 +1,22 @@
+#include "sharded_matmul.h"
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// Worker process started by fhe::ShardedMatMul; not meant to be run by hand.
+// Usage: fhe_shard_worker <context file> <product directory> <worker index>
+
+int main(int argc, char* argv[]) {
+    if (argc != 4) {
+        cerr << "Usage: " << argv[0] << " <context file> <product directory> <worker index>" << endl;
+        return 2;
+    }
+    try {
+        fhe::runShards(argv[1], argv[2], stoul(argv[3]));
+    } catch (const exception& e) {
+        cerr << "fhe_shard_worker " << argv[3] << ": " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
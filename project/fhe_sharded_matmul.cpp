@@ -0,0 +1,101 @@
+#include "openfhe.h"
+#include "pipeline.h"
+#include "sharded_matmul.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+
+using namespace lbcrypto;
+using namespace std;
+
+// Encrypted n x n matrix product split into tile x tile blocks and computed
+// by worker processes (fhe_shard_worker, next to this executable).
+// Usage: fhe_sharded_matmul [n] [tile] [workers] [work directory]
+
+const double acceptable_error = 1e-4;
+
+double elapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        uint32_t n = argc > 1 ? stoul(argv[1]) : 8;
+        uint32_t tile = argc > 2 ? stoul(argv[2]) : 4;
+        fhe::ShardOptions options;
+        options.workers = argc > 3 ? stoul(argv[3]) : 4;
+        if (argc > 4) {
+            options.workDir = argv[4];
+        }
+
+        mt19937 rng(7);
+        uniform_real_distribution<double> entry(-1.0, 1.0);
+        fhe::PlainGrid A(n, vector<double>(n));
+        fhe::PlainGrid B(n, vector<double>(n));
+        for (uint32_t i = 0; i < n; i++) {
+            for (uint32_t j = 0; j < n; j++) {
+                A[i][j] = entry(rng);
+                B[i][j] = entry(rng);
+            }
+        }
+
+        // One tile row or column per ciphertext; EvalInnerProduct sums over the whole batch.
+        uint32_t scaleModSize = 50;
+        CCParams<CryptoContextCKKSRNS> parameters = fhe::makeParameters(1, scaleModSize, tile);
+        CryptoContext<DCRTPoly> cc = GenCryptoContext(parameters);
+        cc->Enable(PKE);
+        cc->Enable(KEYSWITCH);
+        cc->Enable(LEVELEDSHE);
+        cc->Enable(ADVANCEDSHE);
+
+        KeyPair keys = cc->KeyGen();
+        cc->EvalMultKeyGen(keys.secretKey);
+        cc->EvalSumKeyGen(keys.secretKey);
+
+        fhe::ThreadPool pool;
+        fhe::TiledMatrix encryptedA =
+            fhe::encryptTiled(fhe::BatchEncryptor(cc, keys.publicKey, pool), A, tile, fhe::Packing::Rows);
+        fhe::TiledMatrix encryptedB =
+            fhe::encryptTiled(fhe::BatchEncryptor(cc, keys.publicKey, pool), B, tile, fhe::Packing::Columns);
+
+        auto start = chrono::steady_clock::now();
+        fhe::ShardedMatMul sharded(cc, keys.secretKey->GetKeyTag(), options);
+        cout << "Context and eval keys written to " << sharded.Directory() << ": " << elapsedMs(start) << " ms"
+             << endl;
+        start = chrono::steady_clock::now();
+        fhe::TiledMatrix encryptedC = sharded.Multiply(encryptedA, encryptedB);
+        cout << n << "x" << n << " product in " << tile << "x" << tile << " tiles on up to " << options.workers
+             << " worker processes: " << elapsedMs(start) << " ms" << endl;
+
+        fhe::PlainGrid C = fhe::decryptTiled(fhe::BatchDecryptor(cc, keys.secretKey, pool), encryptedC);
+        double maxError = 0.0;
+        for (uint32_t i = 0; i < n; i++) {
+            for (uint32_t j = 0; j < n; j++) {
+                double expected = 0.0;
+                for (uint32_t k = 0; k < n; k++) {
+                    expected += A[i][k] * B[k][j];
+                }
+                maxError = max(maxError, abs(C[i][j] - expected));
+            }
+        }
+        cout << "Max error vs plaintext product: " << maxError << endl;
+
+        if (maxError <= acceptable_error) {
+            cout << "\nSharded Matrix Multiplication Completed successfully." << endl;
+            cout << "Whoopee! Bad guys won't be able to steal my precious numbers 😊" << endl;
+        } else {
+            cout << "\nSharded Matrix Multiplication failing to get expected result. This can be due to unsufficient accuracy or wrong calculations" << endl;
+            cout << "🥺😢" << endl;
+        }
+
+    } catch (const exception& e) {
+        cerr << "Exception: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "fixed_kernels.h"
+#include "accumulator.h"
+#include "instrumentation.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace lbcrypto;
+using namespace std;
+
+namespace fhe {
+
+namespace {
+
+using Precomputed = shared_ptr<vector<DCRTPoly>>;
+
+// sum += mask * rot(x, R), skipped for an all-zero diagonal.
+template <uint32_t R>
+void addDiagonal(const CryptoContext<DCRTPoly>& cc, const Ciphertext<DCRTPoly>& x, const Precomputed& precomputed,
+                 const Plaintext& mask, Accumulator& sum) {
+    if (!mask) {
+        return;
+    }
+    if constexpr (R == 0) {
+        sum.Add(FHE_OP(EvalMult, cc->EvalMult(x, mask)));
+    } else {
+        Ciphertext<DCRTPoly> rotated =
+            FHE_OP(EvalRotate, cc->EvalFastRotation(x, R, cc->GetCyclotomicOrder(), precomputed));
+        sum.Add(FHE_OP(EvalMult, cc->EvalMult(rotated, mask)));
+    }
+}
+
+template <uint32_t N, size_t... D>
+void addDiagonals(const CryptoContext<DCRTPoly>& cc, const Ciphertext<DCRTPoly>& x, const Precomputed& precomputed,
+                  const array<Plaintext, sizeof...(D)>& masks, Accumulator& sum, index_sequence<D...>) {
+    (addDiagonal<FixedMatVec<N>::schedule.offsets[D]>(cc, x, precomputed, masks[D], sum), ...);
+}
+
+// sum += kernel[m][n] * input[i + m][j + n] for tap T = m * K + n.
+template <uint32_t K, size_t... T>
+void addTaps(const FixedMatrix<K>& kernel, const CiphertextGrid& input, size_t i, size_t j, Accumulator& sum,
+             index_sequence<T...>) {
+    auto tap = [&](size_t m, size_t n) {
+        if (kernel[m][n] != 0.0) {
+            sum.MultiplyAdd(input[i + m][j + n], kernel[m][n]);
+        }
+    };
+    (tap(T / K, T % K), ...);
+}
+
+}  // namespace
+
+template <uint32_t N>
+FixedMatVec<N>::FixedMatVec(const CryptoContext<DCRTPoly>& cc, const FixedMatrix<N>& weights) : cc(cc) {
+    const uint32_t batchSize = cc->GetEncodingParams()->GetBatchSize();
+    if (batchSize != schedule.window) {
+        throw invalid_argument("FixedMatVec: expects a batch size of " + to_string(schedule.window) + ", got " +
+                               to_string(batchSize));
+    }
+    bool nonZero = false;
+    for (size_t d = 0; d < masks.size(); d++) {
+        vector<double> diagonal(N, 0.0);
+        for (uint32_t j = 0; j < N; j++) {
+            const int32_t k = schedule.columns[d][j];
+            if (k >= 0) {
+                diagonal[j] = weights[j][k];
+            }
+        }
+        if (any_of(diagonal.begin(), diagonal.end(), [](double w) { return w != 0.0; })) {
+            masks[d] = FHE_OP(Encode, cc->MakeCKKSPackedPlaintext(diagonal));
+            nonZero = true;
+        }
+    }
+    if (!nonZero) {
+        throw invalid_argument("FixedMatVec: weight matrix is all zeros");
+    }
+}
+
+template <uint32_t N>
+vector<int32_t> FixedMatVec<N>::Rotations() {
+    vector<int32_t> rotations;
+    for (uint32_t r : schedule.offsets) {
+        if (r != 0) {
+            rotations.push_back(r);
+        }
+    }
+    return rotations;
+}
+
+template <uint32_t N>
+Ciphertext<DCRTPoly> FixedMatVec<N>::Apply(const Ciphertext<DCRTPoly>& x) const {
+    Precomputed precomputed = FHE_OP(RotationPrecompute, cc->EvalFastRotationPrecompute(x));
+    Accumulator sum(cc);
+    addDiagonals<N>(cc, x, precomputed, masks, sum, make_index_sequence<DiagonalSchedule<N>::Count()>());
+    return sum.Take();
+}
+
+template <uint32_t K>
+FixedConv2D<K>::FixedConv2D(const FixedMatrix<K>& kernel, double bias) : kernel(kernel), bias(bias) {
+    for (const auto& row : kernel) {
+        for (double w : row) {
+            if (w != 0.0) {
+                return;
+            }
+        }
+    }
+    throw invalid_argument("FixedConv2D: kernel is all zeros");
+}
+
+template <uint32_t K>
+CiphertextGrid FixedConv2D<K>::Apply(const CryptoContext<DCRTPoly>& cc, const CiphertextGrid& input,
+                                     ThreadPool* pool) const {
+    if (input.size() < K || input[0].size() < K) {
+        throw invalid_argument("FixedConv2D: input smaller than kernel");
+    }
+    const size_t outRows = input.size() - K + 1;
+    const size_t outCols = input[0].size() - K + 1;
+
+    CiphertextGrid output(outRows, vector<Ciphertext<DCRTPoly>>(outCols));
+    forEachIndex(pool, outRows, [&](size_t i) {
+        Accumulator sum(cc);
+        for (size_t j = 0; j < outCols; j++) {
+            addTaps<K>(kernel, input, i, j, sum, make_index_sequence<K * K>());
+            if (bias != 0.0) {
+                sum.AddConstant(bias);
+            }
+            output[i][j] = sum.Take();
+        }
+    });
+    return output;
+}
+
+template class FixedMatVec<2>;
+template class FixedMatVec<3>;
+template class FixedMatVec<4>;
+template class FixedMatVec<8>;
+template class FixedMatVec<16>;
+
+template class FixedConv2D<2>;
+template class FixedConv2D<3>;
+template class FixedConv2D<5>;
+
+}  // namespace fhe
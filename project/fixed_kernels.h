@@ -0,0 +1,113 @@
+#pragma once
+
+#include "encrypted_matrix.h"
+#include "thread_pool.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace fhe {
+
+// Kernels specialized for shapes known at compile time. Their rotation
+// schedules and mask layouts are constexpr tables and their accumulation is
+// unrolled, so a call does no planning; the weights are encoded once, when
+// the kernel is built. Compiled for these shapes only:
+template <uint32_t N>
+constexpr bool isFixedMatrixSize = N == 2 || N == 3 || N == 4 || N == 8 || N == 16;
+template <uint32_t K>
+constexpr bool isFixedKernelSize = K == 2 || K == 3 || K == 5;
+
+template <uint32_t N>
+using FixedMatrix = std::array<std::array<double, N>, N>;
+
+// Smallest power of two >= n: the cyclic window an n-vector is rotated in,
+// and so the batch size the fixed matrix kernels expect.
+constexpr uint32_t fixedWindow(uint32_t n) {
+    uint32_t window = 1;
+    while (window < n) {
+        window <<= 1;
+    }
+    return window;
+}
+
+// The cyclic diagonals diag_r[j] = W[j][(j + r) mod window] of an N x N
+// matrix that touch it at all, as offsets r and the column every row j reads
+// (-1 past the matrix).
+template <uint32_t N>
+struct DiagonalSchedule {
+    static constexpr uint32_t window = fixedWindow(N);
+
+    static constexpr uint32_t Count() {
+        uint32_t count = 0;
+        for (uint32_t r = 0; r < window; r++) {
+            count += (r < N || r + N > window) ? 1 : 0;
+        }
+        return count;
+    }
+
+    std::array<uint32_t, Count()> offsets{};
+    std::array<std::array<int32_t, N>, Count()> columns{};
+};
+
+template <uint32_t N>
+constexpr DiagonalSchedule<N> diagonalSchedule() {
+    DiagonalSchedule<N> schedule;
+    uint32_t d = 0;
+    for (uint32_t r = 0; r < schedule.window; r++) {
+        if (r >= N && r + N <= schedule.window) {
+            continue;
+        }
+        schedule.offsets[d] = r;
+        for (uint32_t j = 0; j < N; j++) {
+            const uint32_t k = (j + r) % schedule.window;
+            schedule.columns[d][j] = k < N ? static_cast<int32_t>(k) : -1;
+        }
+        d++;
+    }
+    return schedule;
+}
+
+// W x for a fixed N x N weight matrix and x packed in slots [0, N) of one
+// ciphertext, by the diagonal method. The context's batch size must be
+// fixedWindow(N). Apply() is one hoisted rotation and one plaintext product
+// per non-zero diagonal.
+template <uint32_t N>
+class FixedMatVec {
+    static_assert(isFixedMatrixSize<N>, "FixedMatVec: no fixed kernel for this size");
+
+public:
+    static constexpr DiagonalSchedule<N> schedule = diagonalSchedule<N>();
+
+    FixedMatVec(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc, const FixedMatrix<N>& weights);
+
+    // Rotation keys Apply() needs, for EvalRotateKeyGen().
+    static std::vector<int32_t> Rotations();
+
+    lbcrypto::Ciphertext<lbcrypto::DCRTPoly> Apply(const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& x) const;
+
+private:
+    lbcrypto::CryptoContext<lbcrypto::DCRTPoly> cc;
+    // One per diagonal of the schedule; null where W has only zeros.
+    std::array<lbcrypto::Plaintext, DiagonalSchedule<N>::Count()> masks;
+};
+
+// Valid, stride 1 convolution of an Element-packed grid with a fixed K x K
+// plaintext kernel plus a bias, like conv2d(). The taps are unrolled and
+// zero taps cost nothing.
+template <uint32_t K>
+class FixedConv2D {
+    static_assert(isFixedKernelSize<K>, "FixedConv2D: no fixed kernel for this size");
+
+public:
+    explicit FixedConv2D(const FixedMatrix<K>& kernel, double bias = 0.0);
+
+    // With a pool, output rows are computed concurrently.
+    CiphertextGrid Apply(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc, const CiphertextGrid& input,
+                         ThreadPool* pool = nullptr) const;
+
+private:
+    FixedMatrix<K> kernel;
+    double bias;
+};
+
+}  // namespace fhe
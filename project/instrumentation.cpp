@@ -0,0 +1,186 @@
+#include "instrumentation.h"
+#include <functional>
+#include <map>
+#include <thread>
+
+using namespace std;
+
+namespace fhe {
+
+namespace {
+
+const Op allOps[] = {Op::Encode,   Op::Encrypt,          Op::Decrypt,            Op::EvalAdd,
+                     Op::EvalMult, Op::EvalInnerProduct, Op::RotationPrecompute, Op::EvalRotate,
+                     Op::Rescale,  Op::Relinearize,      Op::EvalBootstrap};
+
+double microseconds(Profiler::Clock::duration d) {
+    return chrono::duration<double, micro>(d).count();
+}
+
+// Stage names come from layer names, which are plain identifiers, but quote
+// defensively.
+string quoted(const string& s) {
+    string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+}  // namespace
+
+const char* opName(Op op) {
+    switch (op) {
+        case Op::Encode:
+            return "Encode";
+        case Op::Encrypt:
+            return "Encrypt";
+        case Op::Decrypt:
+            return "Decrypt";
+        case Op::EvalAdd:
+            return "EvalAdd";
+        case Op::EvalMult:
+            return "EvalMult";
+        case Op::EvalInnerProduct:
+            return "EvalInnerProduct";
+        case Op::RotationPrecompute:
+            return "RotationPrecompute";
+        case Op::EvalRotate:
+            return "EvalRotate";
+        case Op::Rescale:
+            return "Rescale";
+        case Op::Relinearize:
+            return "Relinearize";
+        case Op::EvalBootstrap:
+            return "EvalBootstrap";
+    }
+    return "Unknown";
+}
+
+Profiler& Profiler::Instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+uint32_t Profiler::ThreadIndex() {
+    size_t id = hash<thread::id>()(this_thread::get_id());
+    for (uint32_t i = 0; i < threadIds.size(); i++) {
+        if (threadIds[i] == id) {
+            return i;
+        }
+    }
+    threadIds.push_back(id);
+    return threadIds.size() - 1;
+}
+
+void Profiler::Record(Op op, Clock::time_point start, Clock::time_point end) {
+    lock_guard<mutex> lock(eventsMutex);
+    events.push_back({op, currentStage, ThreadIndex(), start, end});
+}
+
+void Profiler::BeginStage(const string& name) {
+    lock_guard<mutex> lock(eventsMutex);
+    currentStage = stages.size();
+    openStages.push_back(currentStage);
+    stages.push_back({name, Clock::now(), {}});
+}
+
+void Profiler::EndStage() {
+    lock_guard<mutex> lock(eventsMutex);
+    if (!openStages.empty()) {
+        stages[openStages.back()].end = Clock::now();
+        openStages.pop_back();
+        currentStage = openStages.empty() ? -1 : openStages.back();
+    }
+}
+
+void Profiler::Reset() {
+    lock_guard<mutex> lock(eventsMutex);
+    events.clear();
+    stages.clear();
+    openStages.clear();
+    currentStage = -1;
+    origin = Clock::now();
+}
+
+string Profiler::CurrentStage() const {
+    lock_guard<mutex> lock(eventsMutex);
+    return currentStage >= 0 ? stages[currentStage].name : string();
+}
+
+Profiler::OpStats Profiler::Stats(Op op) const {
+    lock_guard<mutex> lock(eventsMutex);
+    OpStats stats;
+    for (const auto& event : events) {
+        if (event.op == op) {
+            stats.count++;
+            stats.milliseconds += microseconds(event.end - event.start) / 1000.0;
+        }
+    }
+    return stats;
+}
+
+void Profiler::WriteJson(ostream& out) const {
+    lock_guard<mutex> lock(eventsMutex);
+    map<Op, OpStats> total;
+    vector<map<Op, OpStats>> perStage(stages.size());
+    for (const auto& event : events) {
+        double ms = microseconds(event.end - event.start) / 1000.0;
+        total[event.op].count++;
+        total[event.op].milliseconds += ms;
+        if (event.stage >= 0) {
+            perStage[event.stage][event.op].count++;
+            perStage[event.stage][event.op].milliseconds += ms;
+        }
+    }
+    auto writeOps = [&](const map<Op, OpStats>& ops) {
+        out << "{";
+        bool first = true;
+        for (Op op : allOps) {
+            auto it = ops.find(op);
+            if (it == ops.end()) {
+                continue;
+            }
+            out << (first ? "" : ", ") << quoted(opName(op)) << ": {\"count\": " << it->second.count
+                << ", \"ms\": " << it->second.milliseconds << "}";
+            first = false;
+        }
+        out << "}";
+    };
+
+    out << "{\n  \"ops\": ";
+    writeOps(total);
+    out << ",\n  \"stages\": [";
+    for (size_t i = 0; i < stages.size(); i++) {
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": " << quoted(stages[i].name)
+            << ", \"ms\": " << microseconds(stages[i].end - stages[i].start) / 1000.0 << ", \"ops\": ";
+        writeOps(perStage[i]);
+        out << "}";
+    }
+    out << (stages.empty() ? "]\n}\n" : "\n  ]\n}\n");
+}
+
+void Profiler::WriteChromeTrace(ostream& out) const {
+    lock_guard<mutex> lock(eventsMutex);
+    out << "{\"traceEvents\": [";
+    bool first = true;
+    auto writeEvent = [&](const string& name, const char* category, uint32_t thread, Clock::time_point start,
+                          Clock::time_point end) {
+        out << (first ? "\n" : ",\n") << "  {\"name\": " << quoted(name) << ", \"cat\": \"" << category
+            << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << thread << ", \"ts\": " << microseconds(start - origin)
+            << ", \"dur\": " << microseconds(end - start) << "}";
+        first = false;
+    };
+    for (const auto& stage : stages) {
+        writeEvent(stage.name, "stage", 0, stage.start, stage.end);
+    }
+    for (const auto& event : events) {
+        writeEvent(opName(event.op), "op", event.thread, event.start, event.end);
+    }
+    out << "\n], \"displayTimeUnit\": \"ms\"}\n";
+}
+
+}  // namespace fhe
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "openfhe.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace fhe {
+
+// Homomorphic primitives the library counts and times. With FLEXIBLEAUTO
+// scaling, EvalMult rescales and relinearizes internally, so Rescale and
+// Relinearize only show up for explicit calls.
+enum class Op {
+    Encode,
+    Encrypt,
+    Decrypt,
+    EvalAdd,
+    EvalMult,
+    EvalInnerProduct,
+    RotationPrecompute,
+    EvalRotate,
+    Rescale,
+    Relinearize,
+    EvalBootstrap,
+};
+
+const char* opName(Op op);
+
+// Process-wide recorder for primitive calls and pipeline stages. Only fed by
+// the FHE_OP / FHE_STAGE macros, which compile to nothing unless the library
+// is built with FHE_INSTRUMENTATION.
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Sees every ciphertext an instrumented op returns; see PrecisionTracker.
+    using Observer = std::function<void(Op, const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>&)>;
+
+    struct OpStats {
+        uint64_t count = 0;
+        double milliseconds = 0.0;
+    };
+
+    static Profiler& Instance();
+
+    void Record(Op op, Clock::time_point start, Clock::time_point end);
+    void BeginStage(const std::string& name);
+    void EndStage();
+    void Reset();
+
+    // Name of the innermost open stage, empty outside of any stage.
+    std::string CurrentStage() const;
+
+    // Not synchronized with running ops: install before and remove after.
+    void SetObserver(Observer observer) { this->observer = std::move(observer); }
+
+    OpStats Stats(Op op) const;
+
+    // Per op type and per stage call counts and wall times.
+    void WriteJson(std::ostream& out) const;
+    // Trace Event Format, loadable in chrome://tracing or Perfetto.
+    void WriteChromeTrace(std::ostream& out) const;
+
+    template <typename F>
+    auto Timed(Op op, F&& f) {
+        auto start = Clock::now();
+        auto result = f();
+        Record(op, start, Clock::now());
+        if constexpr (std::is_same_v<decltype(result), lbcrypto::Ciphertext<lbcrypto::DCRTPoly>>) {
+            if (observer) {
+                observer(op, result);
+            }
+        }
+        return result;
+    }
+
+    // For in-place operations: the observer sees `target` after f() ran.
+    template <typename F>
+    void TimedInPlace(Op op, const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& target, F&& f) {
+        auto start = Clock::now();
+        f();
+        Record(op, start, Clock::now());
+        if (observer) {
+            observer(op, target);
+        }
+    }
+
+private:
+    struct Event {
+        Op op;
+        int32_t stage;
+        uint32_t thread;
+        Clock::time_point start;
+        Clock::time_point end;
+    };
+    struct Stage {
+        std::string name;
+        Clock::time_point start;
+        Clock::time_point end;
+    };
+
+    Profiler() : origin(Clock::now()) {}
+    uint32_t ThreadIndex();
+
+    mutable std::mutex eventsMutex;
+    Clock::time_point origin;
+    std::vector<Event> events;
+    std::vector<Stage> stages;
+    // Indices of the open stages, innermost last; nested FHE_STAGE scopes
+    // return to their enclosing stage when they close.
+    std::vector<int32_t> openStages;
+    int32_t currentStage = -1;
+    std::vector<std::size_t> threadIds;
+    Observer observer;
+};
+
+// Attributes the primitives recorded during its lifetime to a named stage.
+class StageScope {
+public:
+    explicit StageScope(const std::string& name) { Profiler::Instance().BeginStage(name); }
+    ~StageScope() { Profiler::Instance().EndStage(); }
+    StageScope(const StageScope&) = delete;
+    StageScope& operator=(const StageScope&) = delete;
+};
+
+}  // namespace fhe
+
+#ifdef FHE_INSTRUMENTATION
+#define FHE_OP(op, ...) ::fhe::Profiler::Instance().Timed(::fhe::Op::op, [&] { return __VA_ARGS__; })
+#define FHE_OP_IN_PLACE(op, target, ...) \
+    ::fhe::Profiler::Instance().TimedInPlace(::fhe::Op::op, target, [&] { __VA_ARGS__; })
+#define FHE_STAGE(name) ::fhe::StageScope fheStageScope(name)
+#else
+#define FHE_OP(op, ...) (__VA_ARGS__)
+#define FHE_OP_IN_PLACE(op, target, ...) (__VA_ARGS__)
+#define FHE_STAGE(name) ((void)0)
+#endif
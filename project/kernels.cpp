@@ -0,0 +1,276 @@
+#include "kernels.h"
+#include "accumulator.h"
+#include "instrumentation.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+using namespace lbcrypto;
+using namespace std;
+
+namespace fhe {
+
+namespace {
+
+uint32_t ceilLog2(uint32_t x) {
+    uint32_t bits = 0;
+    while ((1u << bits) < x) {
+        bits++;
+    }
+    return bits;
+}
+
+// Body of both conv2d() overloads: `taps` and `bias` are in whatever form
+// Accumulator takes, and a null bias is skipped.
+template <typename Tap>
+CiphertextGrid convolve(const CryptoContext<DCRTPoly>& cc, const CiphertextGrid& input, const vector<vector<Tap>>& taps,
+                        const Tap* bias, ThreadPool* pool) {
+    const size_t kRows = taps.size();
+    const size_t kCols = taps[0].size();
+    if (input.size() < kRows || input[0].size() < kCols) {
+        throw invalid_argument("conv2d: input smaller than kernel");
+    }
+    const size_t outRows = input.size() - kRows + 1;
+    const size_t outCols = input[0].size() - kCols + 1;
+
+    CiphertextGrid output(outRows, vector<Ciphertext<DCRTPoly>>(outCols));
+    // One accumulator per output row.
+    forEachIndex(pool, outRows, [&](size_t i) {
+        Accumulator sum(cc);
+        for (size_t j = 0; j < outCols; j++) {
+            for (size_t m = 0; m < kRows; m++) {
+                for (size_t n = 0; n < kCols; n++) {
+                    sum.MultiplyAdd(input[i + m][j + n], taps[m][n]);
+                }
+            }
+            if (bias) {
+                sum.AddConstant(*bias);
+            }
+            output[i][j] = sum.Take();
+        }
+    });
+    return output;
+}
+
+}  // namespace
+
+EncryptedMatrix matMul(const CryptoContext<DCRTPoly>& cc, const EncryptedMatrix& a, const EncryptedMatrix& b,
+                       Accumulation accumulation, ThreadPool* pool) {
+    if (a.Cols() != b.Rows()) {
+        throw invalid_argument("matMul: inner dimensions do not match");
+    }
+    vector<Ciphertext<DCRTPoly>> result(static_cast<size_t>(a.Rows()) * b.Cols());
+    if (a.GetPacking() == Packing::Element && b.GetPacking() == Packing::Element) {
+        // One accumulator per output row.
+        forEachIndex(pool, a.Rows(), [&](size_t i) {
+            Accumulator sum(cc);
+            for (uint32_t j = 0; j < b.Cols(); j++) {
+                for (uint32_t k = 0; k < a.Cols(); k++) {
+                    sum.MultiplyAdd(a.At(i * a.Cols() + k), b.At(static_cast<size_t>(k) * b.Cols() + j),
+                                    accumulation);
+                }
+                result[i * b.Cols() + j] = sum.Take();
+            }
+        });
+        return EncryptedMatrix(Packing::Element, a.Rows(), b.Cols(), move(result));
+    }
+    if (a.GetPacking() != Packing::Rows || b.GetPacking() != Packing::Columns) {
+        throw invalid_argument("matMul: expects A in Rows and B in Columns packing, or both in Element packing");
+    }
+    // Summing over the whole batch leaves the dot product in every slot.
+    const uint32_t batchSize = cc->GetEncodingParams()->GetBatchSize();
+    forEachIndex(pool, result.size(), [&](size_t index) {
+        result[index] =
+            FHE_OP(EvalInnerProduct, cc->EvalInnerProduct(a.At(index / b.Cols()), b.At(index % b.Cols()), batchSize));
+    });
+    return EncryptedMatrix(Packing::Element, a.Rows(), b.Cols(), move(result));
+}
+
+EncryptedMatrix matMul(const CryptoContext<DCRTPoly>& cc, const EncryptedMatrix& a, const EncryptedMatrix& b,
+                       int64_t aBound, int64_t bBound, Accumulation accumulation, ThreadPool* pool) {
+    checkIntegerBound(cc, static_cast<double>(a.Cols()) * aBound * bBound, "matMul");
+    return matMul(cc, a, b, accumulation, pool);
+}
+
+CiphertextGrid conv2d(const CryptoContext<DCRTPoly>& cc, const CiphertextGrid& input, const PlainGrid& kernel,
+                      double bias, ThreadPool* pool) {
+    return convolve(cc, input, kernel, bias != 0.0 ? &bias : nullptr, pool);
+}
+
+CiphertextGrid conv2d(const CryptoContext<DCRTPoly>& cc, const CiphertextGrid& input, const IntGrid& kernel,
+                      int64_t bias, int64_t inputBound, ThreadPool* pool) {
+    checkIntegerRange(cc, kernel);
+    checkIntegerRange(cc, {{bias}});
+    double bound = abs(static_cast<double>(bias));
+    for (const auto& row : kernel) {
+        for (int64_t w : row) {
+            bound += abs(static_cast<double>(w)) * inputBound;
+        }
+    }
+    checkIntegerBound(cc, bound, "conv2d");
+    // Every tap is encoded once, replicated like the Element-packed inputs.
+    const uint32_t batchSize = cc->GetEncodingParams()->GetBatchSize();
+    auto encode = [&](int64_t value) {
+        return FHE_OP(Encode, cc->MakePackedPlaintext(vector<int64_t>(batchSize, value)));
+    };
+    vector<vector<Plaintext>> taps;
+    for (const auto& row : kernel) {
+        taps.emplace_back();
+        for (int64_t w : row) {
+            taps.back().push_back(encode(w));
+        }
+    }
+    Plaintext biasPtx = bias != 0 ? encode(bias) : nullptr;
+    return convolve(cc, input, taps, bias != 0 ? &biasPtx : nullptr, pool);
+}
+
+CiphertextGrid avgPool2d(const CryptoContext<DCRTPoly>& cc, const CiphertextGrid& input, uint32_t size, double scale,
+                         double shift) {
+    const size_t outRows = input.size() / size;
+    const size_t outCols = input.empty() ? 0 : input[0].size() / size;
+    if (outRows == 0 || outCols == 0) {
+        throw invalid_argument("avgPool2d: input smaller than the pooling window");
+    }
+
+    CiphertextGrid output(outRows, vector<Ciphertext<DCRTPoly>>(outCols));
+    Accumulator sum(cc);
+    for (size_t i = 0; i < outRows; i++) {
+        for (size_t j = 0; j < outCols; j++) {
+            for (size_t m = 0; m < size; m++) {
+                for (size_t n = 0; n < size; n++) {
+                    sum.Add(input[i * size + m][j * size + n]);
+                }
+            }
+            if (scale != 1.0) {
+                sum.Scale(scale);
+            }
+            if (shift != 0.0) {
+                sum.AddConstant(shift);
+            }
+            output[i][j] = sum.Take();
+        }
+    }
+    return output;
+}
+
+uint32_t polynomialDepth(const vector<double>& coefficients) {
+    uint32_t depth = 0;
+    for (uint32_t k = 1; k < coefficients.size(); k++) {
+        if (coefficients[k] == 0.0) {
+            continue;
+        }
+        uint32_t termDepth = ceilLog2(k) + (coefficients[k] == 1.0 ? 0 : 1);
+        depth = max(depth, termDepth);
+    }
+    return depth;
+}
+
+Ciphertext<DCRTPoly> evalPolynomial(const CryptoContext<DCRTPoly>& cc, const Ciphertext<DCRTPoly>& x,
+                                    const vector<double>& coefficients) {
+    // Powers are built from the largest power of two below k, so x^k
+    // sits at depth ceil(log2 k) and shared powers are computed once.
+    map<uint32_t, Ciphertext<DCRTPoly>> powers = {{1, x}};
+    function<Ciphertext<DCRTPoly>(uint32_t)> power = [&](uint32_t k) {
+        auto it = powers.find(k);
+        if (it != powers.end()) {
+            return it->second;
+        }
+        uint32_t hi = 1u << (ceilLog2(k) - 1);
+        Ciphertext<DCRTPoly> result = FHE_OP(EvalMult, cc->EvalMult(power(hi), power(k - hi)));
+        powers[k] = result;
+        return result;
+    };
+
+    Accumulator sum(cc);
+    for (uint32_t k = 1; k < coefficients.size(); k++) {
+        if (coefficients[k] == 0.0) {
+            continue;
+        }
+        if (coefficients[k] == 1.0) {
+            sum.Add(power(k));
+        } else {
+            sum.MultiplyAdd(power(k), coefficients[k]);
+        }
+    }
+    if (sum.Empty()) {
+        throw invalid_argument("evalPolynomial: polynomial must have degree >= 1");
+    }
+    if (!coefficients.empty() && coefficients[0] != 0.0) {
+        sum.AddConstant(coefficients[0]);
+    }
+    return sum.Take();
+}
+
+vector<pair<uint32_t, vector<double>>> cyclicDiagonals(const PlainGrid& weights, uint32_t batchSize) {
+    const size_t outputs = weights.size();
+    const size_t inputs = weights.empty() ? 0 : weights[0].size();
+    if (batchSize < max(inputs, outputs)) {
+        throw invalid_argument("cyclicDiagonals: batch size " + to_string(batchSize) + " is smaller than the " +
+                               to_string(outputs) + "x" + to_string(inputs) + " weight matrix");
+    }
+    vector<pair<uint32_t, vector<double>>> diagonals;
+    for (uint32_t r = 0; r < batchSize; r++) {
+        vector<double> diagonal(outputs, 0.0);
+        bool nonZero = false;
+        for (size_t j = 0; j < outputs; j++) {
+            size_t k = (j + r) % batchSize;
+            if (k < inputs && weights[j][k] != 0.0) {
+                diagonal[j] = weights[j][k];
+                nonZero = true;
+            }
+        }
+        if (nonZero) {
+            diagonals.emplace_back(r, move(diagonal));
+        }
+    }
+    return diagonals;
+}
+
+Ciphertext<DCRTPoly> matVecDiagonal(const CryptoContext<DCRTPoly>& cc, const Ciphertext<DCRTPoly>& x,
+                                    const PlainGrid& weights) {
+    // y = sum_r diag_r * rot(x, r). Slots past the input length may hold
+    // anything, they only ever meet zero diagonal entries.
+    const uint32_t batchSize = cc->GetEncodingParams()->GetBatchSize();
+    auto precomputed = FHE_OP(RotationPrecompute, cc->EvalFastRotationPrecompute(x));
+    Accumulator sum(cc);
+    for (const auto& [r, diagonal] : cyclicDiagonals(weights, batchSize)) {
+        Ciphertext<DCRTPoly> rotated =
+            r == 0 ? x : FHE_OP(EvalRotate, cc->EvalFastRotation(x, r, cc->GetCyclotomicOrder(), precomputed));
+        Plaintext mask = FHE_OP(Encode, cc->MakeCKKSPackedPlaintext(diagonal));
+        sum.Add(FHE_OP(EvalMult, cc->EvalMult(rotated, mask)));
+    }
+    if (sum.Empty()) {
+        throw invalid_argument("matVecDiagonal: weight matrix is all zeros");
+    }
+    return sum.Take();
+}
+
+Ciphertext<DCRTPoly> matVecColumns(const CryptoContext<DCRTPoly>& cc, const vector<Ciphertext<DCRTPoly>>& x,
+                                   const PlainGrid& weights) {
+    const size_t outputs = weights.size();
+    if (outputs == 0 || x.size() != weights[0].size()) {
+        throw invalid_argument("matVecColumns: expected " + to_string(outputs == 0 ? 0 : weights[0].size()) +
+                               " input ciphertexts, got " + to_string(x.size()));
+    }
+    Accumulator sum(cc);
+    for (size_t k = 0; k < x.size(); k++) {
+        vector<double> column(outputs);
+        for (size_t j = 0; j < outputs; j++) {
+            column[j] = weights[j][k];
+        }
+        if (all_of(column.begin(), column.end(), [](double w) { return w == 0.0; })) {
+            continue;
+        }
+        Plaintext mask = FHE_OP(Encode, cc->MakeCKKSPackedPlaintext(column));
+        sum.Add(FHE_OP(EvalMult, cc->EvalMult(x[k], mask)));
+    }
+    if (sum.Empty()) {
+        throw invalid_argument("matVecColumns: weight matrix is all zeros");
+    }
+    return sum.Take();
+}
+
+}  // namespace fhe
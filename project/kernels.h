@@ -0,0 +1,73 @@
+#pragma once
+
+#include "encrypted_matrix.h"
+#include "thread_pool.h"
+#include <utility>
+#include <vector>
+
+namespace fhe {
+
+// How a sum of ciphertext-ciphertext products is finished. Eager relinearizes
+// every product as it is made. Lazy adds the raw three-element products and
+// relinearizes and rescales once per output.
+enum class Accumulation { Eager, Lazy };
+
+// C = A B, returned in Element packing. With A in Rows packing and B in
+// Columns packing every entry is one EvalInnerProduct over the batch (needs
+// the EvalSum keys). With both in Element packing every entry is a sum of
+// A.Cols() products, accumulated as `accumulation` says. With a pool, the
+// entries are computed concurrently. Under BFV and BGV the product is exact
+// mod t; there only slot 0 of a Rows x Columns entry is guaranteed to hold it.
+EncryptedMatrix matMul(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc, const EncryptedMatrix& a,
+                       const EncryptedMatrix& b, Accumulation accumulation = Accumulation::Lazy,
+                       ThreadPool* pool = nullptr);
+
+// Exact BFV or BGV product of matrices whose entries are at most `aBound` and
+// `bBound` in magnitude. Throws before computing if an entry of C could wrap
+// mod t, i.e. unless A.Cols() * aBound * bBound < t/2.
+EncryptedMatrix matMul(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc, const EncryptedMatrix& a,
+                       const EncryptedMatrix& b, int64_t aBound, int64_t bBound,
+                       Accumulation accumulation = Accumulation::Lazy, ThreadPool* pool = nullptr);
+
+// Valid (no padding), stride 1 convolution of an Element-packed grid with a
+// plaintext kernel, plus a plaintext bias. With a pool, output rows are
+// computed concurrently.
+CiphertextGrid conv2d(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc, const CiphertextGrid& input,
+                      const PlainGrid& kernel, double bias, ThreadPool* pool = nullptr);
+
+// Exact BFV or BGV counterpart with an integer kernel and bias, for inputs at
+// most `inputBound` in magnitude. Throws before computing if an output could
+// wrap mod t, i.e. unless sum |k| * inputBound + |bias| < t/2.
+CiphertextGrid conv2d(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc, const CiphertextGrid& input,
+                      const IntGrid& kernel, int64_t bias, int64_t inputBound, ThreadPool* pool = nullptr);
+
+// Non-overlapping size x size window sums, times `scale` plus `shift`.
+CiphertextGrid avgPool2d(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc, const CiphertextGrid& input,
+                         uint32_t size, double scale, double shift);
+
+// Levels evalPolynomial() consumes: x^k costs ceil(log2 k), plus one for the
+// coefficient unless it is 1.
+uint32_t polynomialDepth(const std::vector<double>& coefficients);
+
+// sum_k coefficients[k] * x^k, computing each needed power once.
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> evalPolynomial(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                                                        const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& x,
+                                                        const std::vector<double>& coefficients);
+
+// Non-zero cyclic diagonals diag_r[j] = W[j][(j + r) mod batchSize], keyed by r.
+std::vector<std::pair<uint32_t, std::vector<double>>> cyclicDiagonals(const PlainGrid& weights, uint32_t batchSize);
+
+// W x for x packed in one ciphertext (x[k] in slot k): one hoisted rotation
+// and one plaintext product per non-zero cyclic diagonal. Needs rotation keys
+// for the diagonal offsets.
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> matVecDiagonal(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                                                        const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& x,
+                                                        const PlainGrid& weights);
+
+// W x for x given as one Element-packed ciphertext per entry: one plaintext
+// column product per input, no rotations. The result is packed.
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> matVecColumns(
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+    const std::vector<lbcrypto::Ciphertext<lbcrypto::DCRTPoly>>& x, const PlainGrid& weights);
+
+}  // namespace fhe
@@ -0,0 +1,243 @@
+#include "keystore.h"
+#include "mapped_file.h"
+#include "cryptocontext-ser.h"
+#include "key/key-ser.h"
+#include "scheme/ckksrns/ckksrns-ser.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace lbcrypto;
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace fhe {
+
+namespace {
+
+const char* contextFile = "context.bin";
+const char* publicKeyFile = "public.bin";
+const char* secretKeyFile = "secret.bin";
+const char* multKeyFile = "mult.bin";
+const char* automorphismKeyFile = "automorphism.bin";
+
+template <typename Read>
+void readFile(const fs::path& path, Read&& read) {
+    MappedFile file(path.string());
+    MemoryBuffer buffer(file.Data(), file.Size());
+    istream in(&buffer);
+    if (!read(in)) {
+        throw runtime_error("KeyStore: cannot deserialize " + path.string());
+    }
+}
+
+template <typename Write>
+void writeFile(const fs::path& path, Write&& write) {
+    ofstream out(path, ios::binary);
+    if (!out || !write(out) || !out.flush()) {
+        throw runtime_error("KeyStore: cannot write " + path.string());
+    }
+}
+
+// Creates an empty file only the owner can read, before any secret goes in.
+void createPrivateFile(const fs::path& path) {
+    int fd = open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0600);
+    if (fd < 0) {
+        throw runtime_error("KeyStore: cannot create " + path.string() + ": " + strerror(errno));
+    }
+    close(fd);
+}
+
+// FNV-1a, stable across runs and platforms.
+uint64_t fnv1a(const string& text) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+void enableFeatures(const CryptoContext<DCRTPoly>& cc) {
+    cc->Enable(PKE);
+    cc->Enable(KEYSWITCH);
+    cc->Enable(LEVELEDSHE);
+    cc->Enable(ADVANCEDSHE);
+}
+
+}  // namespace
+
+void generateEvalKeys(const CryptoContext<DCRTPoly>& cc, const PrivateKey<DCRTPoly>& secretKey, const KeySpec& spec,
+                      ThreadPool* pool) {
+    if (!pool) {
+        cc->EvalMultKeyGen(secretKey);
+        if (!spec.rotations.empty()) {
+            cc->EvalRotateKeyGen(secretKey, spec.rotations);
+        }
+        if (spec.sumKeys) {
+            cc->EvalSumKeyGen(secretKey);
+        }
+        return;
+    }
+
+    set<uint32_t> automorphisms;
+    for (int32_t r : spec.rotations) {
+        if (r != 0) {
+            automorphisms.insert(cc->FindAutomorphismIndex(r));
+        }
+    }
+    // Under CKKS, EvalSumKeyGen() makes the keys for the rotations by every
+    // power of two below the batch size, so those are spread out too. Other
+    // schemes' sum keys stay one task.
+    const bool ckks = cc->getSchemeId() == SCHEME::CKKSRNS_SCHEME;
+    if (spec.sumKeys && ckks) {
+        uint32_t batchSize = cc->GetEncodingParams()->GetBatchSize();
+        if (batchSize == 0) {
+            batchSize = cc->GetRingDimension() / 2;
+        }
+        for (uint32_t step = 1; step < batchSize; step <<= 1) {
+            automorphisms.insert(cc->FindAutomorphismIndex(step));
+        }
+    }
+    const vector<uint32_t> indices(automorphisms.begin(), automorphisms.end());
+
+    // Task 0 is the relinearization key and task 1 the non-CKKS sum keys; both
+    // go to their own key maps. The rest are one automorphism key each.
+    const size_t fixedTasks = 2;
+    vector<shared_ptr<map<uint32_t, EvalKey<DCRTPoly>>>> generated(indices.size());
+    pool->ParallelFor(fixedTasks + indices.size(), [&](size_t task) {
+        if (task == 0) {
+            cc->EvalMultKeyGen(secretKey);
+        } else if (task == 1) {
+            if (spec.sumKeys && !ckks) {
+                cc->EvalSumKeyGen(secretKey);
+            }
+        } else {
+            generated[task - fixedTasks] =
+                cc->GetScheme()->EvalAutomorphismKeyGen(secretKey, {indices[task - fixedTasks]});
+        }
+    });
+
+    auto merged = make_shared<map<uint32_t, EvalKey<DCRTPoly>>>();
+    for (const auto& keys : generated) {
+        merged->insert(keys->begin(), keys->end());
+    }
+    if (!merged->empty()) {
+        CryptoContextImpl<DCRTPoly>::InsertEvalAutomorphismKey(merged, secretKey->GetKeyTag());
+    }
+}
+
+KeyStore::KeyStore(string directory) : directory(move(directory)) {}
+
+string KeyStore::Fingerprint(const CCParams<CryptoContextCKKSRNS>& parameters, const KeySpec& spec) {
+    vector<int32_t> rotations = spec.rotations;
+    sort(rotations.begin(), rotations.end());
+    rotations.erase(unique(rotations.begin(), rotations.end()), rotations.end());
+
+    ostringstream description;
+    description << parameters << "|rotations:";
+    for (int32_t r : rotations) {
+        description << r << ",";
+    }
+    description << "|sum:" << spec.sumKeys;
+
+    ostringstream hex;
+    hex << std::hex << setw(16) << setfill('0') << fnv1a(description.str());
+    return hex.str();
+}
+
+KeyMaterial KeyStore::Open(const CCParams<CryptoContextCKKSRNS>& parameters, const KeySpec& spec) {
+    fs::path path = fs::path(directory) / Fingerprint(parameters, spec);
+    KeyMaterial material = fs::exists(path) ? Load(path.string()) : Generate(parameters, spec, path.string());
+    enableFeatures(material.cc);
+    return material;
+}
+
+KeyMaterial KeyStore::Load(const string& path) const {
+    const fs::path dir(path);
+    KeyMaterial material;
+    readFile(dir / contextFile, [&](istream& in) {
+        Serial::Deserialize(material.cc, in, SerType::BINARY);
+        return material.cc != nullptr;
+    });
+    readFile(dir / publicKeyFile, [&](istream& in) {
+        Serial::Deserialize(material.keys.publicKey, in, SerType::BINARY);
+        return material.keys.publicKey != nullptr;
+    });
+    readFile(dir / secretKeyFile, [&](istream& in) {
+        Serial::Deserialize(material.keys.secretKey, in, SerType::BINARY);
+        return material.keys.secretKey != nullptr;
+    });
+    readFile(dir / multKeyFile,
+             [&](istream& in) { return CryptoContextImpl<DCRTPoly>::DeserializeEvalMultKey(in, SerType::BINARY); });
+    if (fs::exists(dir / automorphismKeyFile)) {
+        readFile(dir / automorphismKeyFile, [&](istream& in) {
+            return CryptoContextImpl<DCRTPoly>::DeserializeEvalAutomorphismKey(in, SerType::BINARY);
+        });
+    }
+    material.loaded = true;
+    return material;
+}
+
+KeyMaterial KeyStore::Generate(const CCParams<CryptoContextCKKSRNS>& parameters, const KeySpec& spec,
+                               const string& path) const {
+    KeyMaterial material;
+    material.cc = GenCryptoContext(parameters);
+    enableFeatures(material.cc);
+    material.keys = material.cc->KeyGen();
+    const PrivateKey<DCRTPoly>& secretKey = material.keys.secretKey;
+    ThreadPool pool;
+    generateEvalKeys(material.cc, secretKey, spec, &pool);
+
+    // Written to a private directory and renamed into place, so a concurrent
+    // or interrupted run never sees a partial entry.
+    fs::create_directories(directory);
+    fs::path staging = fs::path(path + ".tmp-" + to_string(getpid()));
+    fs::remove_all(staging);  // left over by a crashed run with the same pid
+    if (mkdir(staging.c_str(), 0700) != 0) {
+        throw runtime_error("KeyStore: cannot create " + staging.string() + ": " + strerror(errno));
+    }
+    const string keyTag = secretKey->GetKeyTag();
+    writeFile(staging / contextFile, [&](ostream& out) {
+        Serial::Serialize(material.cc, out, SerType::BINARY);
+        return true;
+    });
+    writeFile(staging / publicKeyFile, [&](ostream& out) {
+        Serial::Serialize(material.keys.publicKey, out, SerType::BINARY);
+        return true;
+    });
+    createPrivateFile(staging / secretKeyFile);
+    writeFile(staging / secretKeyFile, [&](ostream& out) {
+        Serial::Serialize(secretKey, out, SerType::BINARY);
+        return true;
+    });
+    writeFile(staging / multKeyFile, [&](ostream& out) {
+        return CryptoContextImpl<DCRTPoly>::SerializeEvalMultKey(out, SerType::BINARY, keyTag);
+    });
+    // Rotation and EvalSum keys share the automorphism key map.
+    if (!spec.rotations.empty() || spec.sumKeys) {
+        writeFile(staging / automorphismKeyFile, [&](ostream& out) {
+            return CryptoContextImpl<DCRTPoly>::SerializeEvalAutomorphismKey(out, SerType::BINARY, keyTag);
+        });
+    }
+
+    error_code error;
+    fs::rename(staging, path, error);
+    if (error) {
+        // Another process stored the same entry first; its keys are as good.
+        fs::remove_all(staging);
+    }
+    return material;
+}
+
+}  // namespace fhe
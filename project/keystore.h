@@ -0,0 +1,60 @@
+#pragma once
+
+#include "openfhe.h"
+#include "thread_pool.h"
+#include <string>
+#include <vector>
+
+namespace fhe {
+
+// Eval keys a context needs besides relinearization.
+struct KeySpec {
+    std::vector<int32_t> rotations;
+    bool sumKeys = false;
+};
+
+struct KeyMaterial {
+    lbcrypto::CryptoContext<lbcrypto::DCRTPoly> cc;
+    lbcrypto::KeyPair<lbcrypto::DCRTPoly> keys;
+    // False when the keys were generated by this call.
+    bool loaded = false;
+};
+
+// Generates the relinearization key and the eval keys of `spec` under
+// `secretKey`'s tag: the keys EvalMultKeyGen(), EvalRotateKeyGen() and
+// EvalSumKeyGen() would make. With a pool, every key is its own task; the
+// automorphism keys are generated into private maps and merged into the
+// context on the calling thread once all are done. Without one, the
+// context's generators run in order.
+void generateEvalKeys(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                      const lbcrypto::PrivateKey<lbcrypto::DCRTPoly>& secretKey, const KeySpec& spec,
+                      ThreadPool* pool = nullptr);
+
+// On-disk cache of a CKKS context with its key pair and eval keys, one
+// directory per Fingerprint(). The first Open() for a configuration pays for
+// keygen and writes everything in OpenFHE's binary format; later runs map the
+// files and deserialize straight from memory. Keygen on a miss runs on one
+// worker per hardware thread. The secret key is stored too, created
+// readable by the owner only inside an owner-only directory.
+class KeyStore {
+public:
+    explicit KeyStore(std::string directory);
+
+    // Loads the context and keys for `parameters` and `spec`, generating and
+    // saving them on a miss. Enables PKE, KEYSWITCH, LEVELEDSHE and
+    // ADVANCEDSHE.
+    KeyMaterial Open(const lbcrypto::CCParams<lbcrypto::CryptoContextCKKSRNS>& parameters, const KeySpec& spec);
+
+    // Hash of the parameters and key spec, in hex.
+    static std::string Fingerprint(const lbcrypto::CCParams<lbcrypto::CryptoContextCKKSRNS>& parameters,
+                                   const KeySpec& spec);
+
+private:
+    KeyMaterial Load(const std::string& path) const;
+    KeyMaterial Generate(const lbcrypto::CCParams<lbcrypto::CryptoContextCKKSRNS>& parameters, const KeySpec& spec,
+                         const std::string& path) const;
+
+    std::string directory;
+};
+
+}  // namespace fhe
@@ -0,0 +1,37 @@
+#include "mapped_file.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace fhe {
+
+MappedFile::MappedFile(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("MappedFile: cannot open " + path + ": " + strerror(errno));
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        throw runtime_error("MappedFile: " + path + " is empty or unreadable");
+    }
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw runtime_error("MappedFile: cannot map " + path + ": " + strerror(errno));
+    }
+    data = static_cast<const char*>(mapped);
+    size = info.st_size;
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<char*>(data), size);
+}
+
+}  // namespace fhe
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <streambuf>
+#include <string>
+
+namespace fhe {
+
+// Read-only memory map of a whole file.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* Data() const { return data; }
+    std::size_t Size() const { return size; }
+
+private:
+    const char* data = nullptr;
+    std::size_t size = 0;
+};
+
+// Lets stream-based deserializers read a memory range in place.
+class MemoryBuffer : public std::streambuf {
+public:
+    MemoryBuffer(const char* data, std::size_t size) {
+        char* begin = const_cast<char*>(data);
+        setg(begin, begin, begin + size);
+    }
+};
+
+}  // namespace fhe
@@ -1,4 +1,6 @@
 #include "openfhe.h"
+#include "kernels.h"
+#include "batch_crypto.h"
 #include <iostream>
 #include <vector>
 #include <cmath>
@@ -12,10 +14,8 @@ void homomorphicMatrixMultiplication() {
 
     // Matrix dimensions (N x N)
     const uint32_t N = 2;
-    vector<double> A_row1 = {1.0, 2.0};
-    vector<double> A_row2 = {3.0, 4.0};
-    vector<double> B_col1 = {5.0, 7.0};
-    vector<double> B_col2 = {6.0, 8.0};
+    fhe::PlainGrid A = {{1.0, 2.0}, {3.0, 4.0}};
+    fhe::PlainGrid B = {{5.0, 6.0}, {7.0, 8.0}};
     vector<double> expected = {19.0, 22.0, 43.0, 50.0};
 
 
@@ -24,7 +24,8 @@ void homomorphicMatrixMultiplication() {
     CCParams<CryptoContextCKKSRNS> parameters;
     parameters.SetMultiplicativeDepth(2);
     parameters.SetScalingModSize(scaleModSize);
-    parameters.SetBatchSize(8);
+    // One row or column per ciphertext; EvalInnerProduct sums over the whole batch.
+    parameters.SetBatchSize(N);
 
     CryptoContext<DCRTPoly> cc = GenCryptoContext(parameters);
 
@@ -45,29 +46,25 @@ void homomorphicMatrixMultiplication() {
     iota(shifts.begin(), shifts.end(), 1);
     cc->EvalAutomorphismKeyGen(keys.secretKey, shifts);
 
-    // Encoding matrix
-    Plaintext plaintextARow1 = cc->MakeCKKSPackedPlaintext(A_row1, scaleModSize, 0);
-    Plaintext plaintextARow2 = cc->MakeCKKSPackedPlaintext(A_row2, scaleModSize, 0);
-    Ciphertext<DCRTPoly> ciphertextARow1 = cc->Encrypt(keys.publicKey, plaintextARow1);
-    Ciphertext<DCRTPoly> ciphertextARow2 = cc->Encrypt(keys.publicKey, plaintextARow2);
-    uint32_t currentScaleSize = scaleModSize;
-    size_t currentLevel = ciphertextARow1->GetLevel();
+    // Encoding matrix: A row by row, B column by column, in parallel
+    fhe::ThreadPool pool;
+    fhe::BatchEncryptor encryptor(cc, keys.publicKey, pool);
+    fhe::EncryptedMatrix encryptedA = encryptor.Encrypt(A, fhe::Packing::Rows);
+    fhe::EncryptedMatrix encryptedB = encryptor.Encrypt(B, fhe::Packing::Columns);
 
-    Plaintext plaintextBCol1 = cc->MakeCKKSPackedPlaintext(B_col1, currentScaleSize, currentLevel);
-    Plaintext plaintextBCol2 = cc->MakeCKKSPackedPlaintext(B_col2, currentScaleSize, currentLevel);
-    Ciphertext<DCRTPoly> ciphertextBCol1 = cc->Encrypt(keys.publicKey, plaintextBCol1);
-    Ciphertext<DCRTPoly> ciphertextBCol2 = cc->Encrypt(keys.publicKey, plaintextBCol2);
+    // Matrix multiplication, the four inner products running concurrently
+    fhe::EncryptedMatrix encryptedC = fhe::matMul(cc, encryptedA, encryptedB, fhe::Accumulation::Lazy, &pool);
 
-
-    // Matrix multiplication
-    Ciphertext<DCRTPoly> ciphertextResult11 = cc->EvalInnerProduct(ciphertextARow1, ciphertextBCol1, N);
-    Ciphertext<DCRTPoly> ciphertextResult12 = cc->EvalInnerProduct(ciphertextARow1, ciphertextBCol2, N);
-    Ciphertext<DCRTPoly> ciphertextResult21 = cc->EvalInnerProduct(ciphertextARow2, ciphertextBCol1, N);
-    Ciphertext<DCRTPoly> ciphertextResult22 = cc->EvalInnerProduct(ciphertextARow2, ciphertextBCol2, N);
+    // Same product with one element per ciphertext: each entry sums N
+    // products and relinearizes once, instead of once per product.
+    fhe::EncryptedMatrix elementC = fhe::matMul(cc, encryptor.Encrypt(A, fhe::Packing::Element),
+                                                encryptor.Encrypt(B, fhe::Packing::Element), fhe::Accumulation::Lazy,
+                                                &pool);
 
     // Decrypting and verifying result
-    Plaintext result;
-    vector<Ciphertext<DCRTPoly>> ciphertextResult = {ciphertextResult11, ciphertextResult12, ciphertextResult21, ciphertextResult22};
+    fhe::BatchDecryptor decryptor(cc, keys.secretKey, pool);
+    fhe::PlainGrid C = decryptor.Decrypt(encryptedC);
+    fhe::PlainGrid elementResult = decryptor.Decrypt(elementC);
     vector<string> labels = {"C[0][0]", "C[0][1]", "C[1][0]", "C[1][1]"};
     
     cout << "\nDecrypted Result Matrix C = A * B (Expected result: [[19, 22], [43, 50]]):" << endl;
@@ -75,9 +72,8 @@ void homomorphicMatrixMultiplication() {
     bool success = true;
     double value;
     double diff;
-    for (size_t i = 0; i < ciphertextResult.size(); ++i) {
-        cc->Decrypt(keys.secretKey, ciphertextResult[i], &result);
-        value = result->GetCKKSPackedValue()[0].real();
+    for (size_t i = 0; i < labels.size(); ++i) {
+        value = C[i / N][i % N];
         diff = abs(value - expected[i]);
         
         cout << "   " << labels[i] << " (Result): " << value << " | expected: " << expected[i] << " | Error: " << diff << endl;
@@ -86,6 +82,14 @@ void homomorphicMatrixMultiplication() {
             success = false;
         }
     }
+    double elementDiff = 0.0;
+    for (size_t i = 0; i < labels.size(); ++i) {
+        elementDiff = max(elementDiff, abs(elementResult[i / N][i % N] - expected[i]));
+    }
+    cout << "   Element packing, lazy relinearization | max error: " << elementDiff << endl;
+    if (elementDiff > 0.000001) {
+        success = false;
+    }
     if (success){
         cout << "\nFully Homomorphic Matrix Multiplication Completed successfully." << endl;
         cout << "Whoopee! Bad guys won't be able to steal my precious numbers 😊" << endl;
@@ -0,0 +1,161 @@
+#include "model.h"
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace fhe {
+
+namespace {
+
+// Reads whitespace separated tokens, skipping '#' comments.
+class TokenReader {
+public:
+    explicit TokenReader(istream& in) {
+        string line;
+        while (getline(in, line)) {
+            line = line.substr(0, line.find('#'));
+            stream << line << '\n';
+        }
+    }
+
+    bool Next(string& token) { return static_cast<bool>(stream >> token); }
+
+    double Number(const string& what) {
+        string token;
+        if (!Next(token)) {
+            throw runtime_error("loadModel: unexpected end of file reading " + what);
+        }
+        try {
+            size_t used = 0;
+            double value = stod(token, &used);
+            if (used == token.size()) {
+                return value;
+            }
+        } catch (const logic_error&) {
+        }
+        throw runtime_error("loadModel: expected a number for " + what + ", got '" + token + "'");
+    }
+
+    uint32_t Count(const string& what) {
+        double value = Number(what);
+        if (value < 1 || value != floor(value)) {
+            throw runtime_error("loadModel: " + what + " must be a positive integer");
+        }
+        return static_cast<uint32_t>(value);
+    }
+
+private:
+    stringstream stream;
+};
+
+double silu(double x) {
+    return x / (1.0 + exp(-x));
+}
+
+}  // namespace
+
+uint32_t Model::BatchSize() const {
+    size_t needed = 1;
+    for (const auto& layer : pipeline.Layers()) {
+        if (auto dense = dynamic_pointer_cast<DenseLayer>(layer)) {
+            needed = max({needed, dense->Inputs(), dense->Outputs()});
+        }
+    }
+    uint32_t batchSize = 1;
+    while (batchSize < needed) {
+        batchSize <<= 1;
+    }
+    return batchSize;
+}
+
+Model loadModel(istream& in) {
+    TokenReader reader(in);
+    Model model;
+    bool haveInput = false;
+    bool haveFitted = false;
+
+    string keyword;
+    while (reader.Next(keyword)) {
+        if (keyword == "input") {
+            model.inputRows = reader.Count("input rows");
+            model.inputCols = reader.Count("input cols");
+            model.inputRange.lo = reader.Number("input range");
+            model.inputRange.hi = reader.Number("input range");
+            haveInput = true;
+        } else if (keyword == "conv") {
+            uint32_t rows = reader.Count("conv rows");
+            uint32_t cols = reader.Count("conv cols");
+            PlainGrid kernel(rows, vector<double>(cols));
+            for (auto& row : kernel) {
+                for (auto& k : row) {
+                    k = reader.Number("conv weight");
+                }
+            }
+            double bias = reader.Number("conv bias");
+            model.pipeline.Add(make_shared<Conv2DLayer>(kernel, bias));
+        } else if (keyword == "activation") {
+            string kind;
+            if (!reader.Next(kind)) {
+                throw runtime_error("loadModel: missing activation kind");
+            }
+            if (kind == "silu") {
+                model.pipeline.Add(make_shared<PolynomialActivationLayer>("silu", silu, reader.Count("silu degree")));
+                haveFitted = true;
+            } else if (kind == "square") {
+                model.pipeline.Add(make_shared<PolynomialActivationLayer>("square", vector<double>{0.0, 0.0, 1.0}));
+            } else if (kind == "poly") {
+                uint32_t degree = reader.Count("poly degree");
+                vector<double> coefficients(degree + 1);
+                for (auto& c : coefficients) {
+                    c = reader.Number("poly coefficient");
+                }
+                model.pipeline.Add(make_shared<PolynomialActivationLayer>("poly", coefficients));
+            } else {
+                throw runtime_error("loadModel: unknown activation '" + kind + "'");
+            }
+        } else if (keyword == "avgpool") {
+            model.pipeline.Add(make_shared<AvgPool2DLayer>(reader.Count("avgpool size")));
+        } else if (keyword == "dense") {
+            uint32_t outputs = reader.Count("dense outputs");
+            uint32_t inputs = reader.Count("dense inputs");
+            PlainGrid weights(outputs, vector<double>(inputs));
+            for (auto& row : weights) {
+                for (auto& w : row) {
+                    w = reader.Number("dense weight");
+                }
+            }
+            vector<double> bias(outputs);
+            for (auto& b : bias) {
+                b = reader.Number("dense bias");
+            }
+            model.pipeline.Add(make_shared<DenseLayer>(weights, bias));
+        } else {
+            throw runtime_error("loadModel: unknown keyword '" + keyword + "'");
+        }
+    }
+
+    if (!haveInput) {
+        throw runtime_error("loadModel: missing 'input' line");
+    }
+    if (model.pipeline.Layers().empty()) {
+        throw runtime_error("loadModel: model has no layers");
+    }
+    if (haveFitted) {
+        model.pipeline.FoldNormalization(model.inputRange);
+    }
+    return model;
+}
+
+Model loadModel(const string& path) {
+    ifstream in(path);
+    if (!in) {
+        throw runtime_error("loadModel: cannot open " + path);
+    }
+    return loadModel(in);
+}
+
+}  // namespace fhe
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "pipeline.h"
+#include <istream>
+#include <string>
+
+namespace fhe {
+
+// A small CNN read from a weight file, ready to run as a Pipeline.
+//
+// The format is whitespace separated; '#' starts a comment:
+//
+//   input <rows> <cols> <lo> <hi>        image shape and pixel range
+//   conv <rows> <cols> <weights...> <bias>
+//   activation silu <degree>             Chebyshev fit of the real SiLU
+//   activation square
+//   activation poly <degree> <c0> ... <c_degree>
+//   avgpool <size>
+//   dense <outputs> <inputs> <weights...> <biases...>
+//
+// Layers run in file order. Fitted activations are range-normalized into the
+// preceding linear layer (see Pipeline::FoldNormalization).
+struct Model {
+    uint32_t inputRows = 0;
+    uint32_t inputCols = 0;
+    Range inputRange = {0.0, 1.0};
+    Pipeline pipeline;
+
+    // Smallest power-of-two batch size that holds every packed vector.
+    uint32_t BatchSize() const;
+
+    GridShape InputShape() const { return {inputRows, inputCols}; }
+};
+
+Model loadModel(std::istream& in);
+Model loadModel(const std::string& path);
+
+}  // namespace fhe
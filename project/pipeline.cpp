@@ -0,0 +1,520 @@
+#include "pipeline.h"
+#include "instrumentation.h"
+#include "kernels.h"
+#include "rotation_key_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <set>
+#include <stdexcept>
+
+using namespace lbcrypto;
+using namespace std;
+
+namespace fhe {
+
+namespace {
+
+// Chebyshev interpolation of f on [-1, 1], returned in the monomial basis.
+vector<double> chebyshevFit(const function<double(double)>& f, uint32_t degree) {
+    const uint32_t nodes = degree + 1;
+    vector<double> values(nodes);
+    vector<double> xs(nodes);
+    for (uint32_t j = 0; j < nodes; j++) {
+        xs[j] = cos(M_PI * (j + 0.5) / nodes);
+        values[j] = f(xs[j]);
+    }
+
+    // T_0 = 1, T_1 = t, T_{k+1} = 2t T_k - T_{k-1}
+    vector<double> monomial(nodes, 0.0);
+    vector<double> tPrev(nodes, 0.0);
+    vector<double> tCur(nodes, 0.0);
+    tPrev[0] = 1.0;
+    for (uint32_t k = 0; k < nodes; k++) {
+        const vector<double>& tk = k == 0 ? tPrev : tCur;
+        double c = 0.0;
+        for (uint32_t j = 0; j < nodes; j++) {
+            c += values[j] * cos(k * acos(xs[j]));
+        }
+        c *= (k == 0 ? 1.0 : 2.0) / nodes;
+        for (uint32_t i = 0; i < nodes; i++) {
+            monomial[i] += c * tk[i];
+        }
+        if (k == 0) {
+            tCur[1] = 1.0;
+        } else {
+            vector<double> tNext(nodes, 0.0);
+            for (uint32_t i = 0; i + 1 < nodes; i++) {
+                tNext[i + 1] += 2.0 * tCur[i];
+            }
+            for (uint32_t i = 0; i < nodes; i++) {
+                tNext[i] -= tPrev[i];
+            }
+            tPrev = tCur;
+            tCur = tNext;
+        }
+    }
+    return monomial;
+}
+
+}  // namespace
+
+Conv2DLayer::Conv2DLayer(PlainGrid kernel, double bias) : kernel(move(kernel)), bias(bias) {
+    if (this->kernel.empty() || this->kernel[0].empty()) {
+        throw invalid_argument("Conv2DLayer: empty kernel");
+    }
+}
+
+CiphertextGrid Conv2DLayer::Forward(const CryptoContext<DCRTPoly>& cc, const CiphertextGrid& input) const {
+    return conv2d(cc, input, kernel, bias);
+}
+
+PlainGrid Conv2DLayer::Reference(const PlainGrid& input) const {
+    const size_t kRows = kernel.size();
+    const size_t kCols = kernel[0].size();
+    const size_t outRows = input.size() - kRows + 1;
+    const size_t outCols = input[0].size() - kCols + 1;
+
+    PlainGrid output(outRows, vector<double>(outCols, bias));
+    for (size_t i = 0; i < outRows; i++) {
+        for (size_t j = 0; j < outCols; j++) {
+            for (size_t m = 0; m < kRows; m++) {
+                for (size_t n = 0; n < kCols; n++) {
+                    output[i][j] += input[i + m][j + n] * kernel[m][n];
+                }
+            }
+        }
+    }
+    return output;
+}
+
+Range Conv2DLayer::OutputRange(const Range& input) const {
+    Range output = {bias, bias};
+    for (const auto& row : kernel) {
+        for (double k : row) {
+            output.lo += min(k * input.lo, k * input.hi);
+            output.hi += max(k * input.lo, k * input.hi);
+        }
+    }
+    return output;
+}
+
+GridShape Conv2DLayer::OutputShape(const GridShape& input) const {
+    if (input.rows < kernel.size() || input.cols < kernel[0].size()) {
+        throw invalid_argument("Conv2DLayer: input smaller than kernel");
+    }
+    return {input.rows - kernel.size() + 1, input.cols - kernel[0].size() + 1};
+}
+
+void Conv2DLayer::FoldAffine(double scale, double shift) {
+    for (auto& row : kernel) {
+        for (auto& k : row) {
+            k *= scale;
+        }
+    }
+    bias = bias * scale + shift;
+}
+
+DenseLayer::DenseLayer(PlainGrid weights, vector<double> bias) : weights(move(weights)), bias(move(bias)) {
+    if (this->weights.empty() || this->weights[0].empty()) {
+        throw invalid_argument("DenseLayer: empty weight matrix");
+    }
+    for (const auto& row : this->weights) {
+        if (row.size() != this->weights[0].size()) {
+            throw invalid_argument("DenseLayer: ragged weight matrix");
+        }
+    }
+    if (this->bias.empty()) {
+        this->bias.assign(this->weights.size(), 0.0);
+    }
+    if (this->bias.size() != this->weights.size()) {
+        throw invalid_argument("DenseLayer: bias size does not match the number of outputs");
+    }
+}
+
+CiphertextGrid DenseLayer::Forward(const CryptoContext<DCRTPoly>& cc, const CiphertextGrid& input) const {
+    vector<Ciphertext<DCRTPoly>> cells = EncryptedMatrix::FromGrid(input).Ciphertexts();
+    Ciphertext<DCRTPoly> y;
+    if (cells.size() == 1) {
+        y = matVecDiagonal(cc, cells[0], weights);
+    } else if (cells.size() == Inputs()) {
+        y = matVecColumns(cc, cells, weights);
+    } else {
+        throw invalid_argument("DenseLayer: expected " + to_string(Inputs()) +
+                               " scalar ciphertexts or one packed ciphertext, got " + to_string(cells.size()));
+    }
+    Plaintext biasPtx = FHE_OP(Encode, cc->MakeCKKSPackedPlaintext(bias));
+    FHE_OP_IN_PLACE(EvalAdd, y, cc->EvalAddInPlace(y, biasPtx));
+    return {{y}};
+}
+
+PlainGrid DenseLayer::Reference(const PlainGrid& input) const {
+    vector<double> x;
+    for (const auto& row : input) {
+        x.insert(x.end(), row.begin(), row.end());
+    }
+    if (x.size() != Inputs()) {
+        throw invalid_argument("DenseLayer: expected " + to_string(Inputs()) + " inputs, got " + to_string(x.size()));
+    }
+    vector<double> y = bias;
+    for (size_t j = 0; j < Outputs(); j++) {
+        for (size_t k = 0; k < Inputs(); k++) {
+            y[j] += weights[j][k] * x[k];
+        }
+    }
+    return {y};
+}
+
+Range DenseLayer::OutputRange(const Range& input) const {
+    // Empty until the first output row widens it.
+    Range output = {numeric_limits<double>::infinity(), -numeric_limits<double>::infinity()};
+    for (size_t j = 0; j < Outputs(); j++) {
+        Range row = {bias[j], bias[j]};
+        for (double w : weights[j]) {
+            row.lo += min(w * input.lo, w * input.hi);
+            row.hi += max(w * input.lo, w * input.hi);
+        }
+        output.lo = min(output.lo, row.lo);
+        output.hi = max(output.hi, row.hi);
+    }
+    return output;
+}
+
+void DenseLayer::FoldAffine(double scale, double shift) {
+    for (auto& row : weights) {
+        for (auto& w : row) {
+            w *= scale;
+        }
+    }
+    for (auto& b : bias) {
+        b = b * scale + shift;
+    }
+}
+
+vector<int32_t> DenseLayer::RotationIndices(uint32_t batchSize, const GridShape& input) const {
+    vector<int32_t> indices;
+    // Scalar cells go through matVecColumns(), which does not rotate.
+    if (input.rows * input.cols != 1) {
+        return indices;
+    }
+    for (const auto& diagonal : cyclicDiagonals(weights, batchSize)) {
+        if (diagonal.first != 0) {
+            indices.push_back(static_cast<int32_t>(diagonal.first));
+        }
+    }
+    return indices;
+}
+
+AvgPool2DLayer::AvgPool2DLayer(uint32_t size) : size(size), scale(1.0 / (size * size)) {
+    if (size == 0) {
+        throw invalid_argument("AvgPool2DLayer: window size must be positive");
+    }
+}
+
+CiphertextGrid AvgPool2DLayer::Forward(const CryptoContext<DCRTPoly>& cc, const CiphertextGrid& input) const {
+    return avgPool2d(cc, input, size, scale, shift);
+}
+
+PlainGrid AvgPool2DLayer::Reference(const PlainGrid& input) const {
+    const size_t outRows = input.size() / size;
+    const size_t outCols = input.empty() ? 0 : input[0].size() / size;
+    PlainGrid output(outRows, vector<double>(outCols, 0.0));
+    for (size_t i = 0; i < outRows; i++) {
+        for (size_t j = 0; j < outCols; j++) {
+            for (size_t m = 0; m < size; m++) {
+                for (size_t n = 0; n < size; n++) {
+                    output[i][j] += input[i * size + m][j * size + n];
+                }
+            }
+            output[i][j] = output[i][j] * scale + shift;
+        }
+    }
+    return output;
+}
+
+Range AvgPool2DLayer::OutputRange(const Range& input) const {
+    const double window = size * size;
+    double lo = window * input.lo * scale + shift;
+    double hi = window * input.hi * scale + shift;
+    return {min(lo, hi), max(lo, hi)};
+}
+
+GridShape AvgPool2DLayer::OutputShape(const GridShape& input) const {
+    return {input.rows / size, input.cols / size};
+}
+
+void AvgPool2DLayer::FoldAffine(double scale, double shift) {
+    this->scale *= scale;
+    this->shift = this->shift * scale + shift;
+}
+
+PolynomialActivationLayer::PolynomialActivationLayer(string name, vector<double> coefficients)
+    : name(move(name)), coefficients(move(coefficients)) {
+    while (!this->coefficients.empty() && this->coefficients.back() == 0.0) {
+        this->coefficients.pop_back();
+    }
+    if (this->coefficients.size() < 2) {
+        throw invalid_argument("PolynomialActivationLayer: polynomial must have degree >= 1");
+    }
+}
+
+PolynomialActivationLayer::PolynomialActivationLayer(string name, function<double(double)> target, uint32_t degree)
+    : name(move(name)), target(move(target)), degree(degree) {
+    if (degree < 1) {
+        throw invalid_argument("PolynomialActivationLayer: polynomial must have degree >= 1");
+    }
+    Fit(domain);
+}
+
+void PolynomialActivationLayer::Fit(const Range& domain) {
+    if (!target) {
+        throw logic_error("PolynomialActivationLayer: " + name + " has no target function to fit");
+    }
+    this->domain = domain;
+    const double center = (domain.lo + domain.hi) / 2.0;
+    const double halfWidth = (domain.hi - domain.lo) / 2.0;
+    coefficients = chebyshevFit([&](double t) { return target(center + halfWidth * t); }, degree);
+    while (coefficients.size() > 2 && coefficients.back() == 0.0) {
+        coefficients.pop_back();
+    }
+}
+
+uint32_t PolynomialActivationLayer::Depth() const {
+    return polynomialDepth(coefficients);
+}
+
+CiphertextGrid PolynomialActivationLayer::Forward(const CryptoContext<DCRTPoly>& cc,
+                                                  const CiphertextGrid& input) const {
+    CiphertextGrid output(input.size(), vector<Ciphertext<DCRTPoly>>(input.empty() ? 0 : input[0].size()));
+    for (size_t i = 0; i < input.size(); i++) {
+        for (size_t j = 0; j < input[i].size(); j++) {
+            output[i][j] = evalPolynomial(cc, input[i][j], coefficients);
+        }
+    }
+    return output;
+}
+
+PlainGrid PolynomialActivationLayer::Reference(const PlainGrid& input) const {
+    PlainGrid output = input;
+    for (auto& row : output) {
+        for (auto& x : row) {
+            // Horner's rule
+            double value = 0.0;
+            for (size_t k = coefficients.size(); k-- > 0;) {
+                value = value * x + coefficients[k];
+            }
+            x = value;
+        }
+    }
+    return output;
+}
+
+Range PolynomialActivationLayer::OutputRange(const Range& input) const {
+    // Sampled bound: exact at the end points, dense enough for the low degrees used here.
+    const uint32_t samples = 256;
+    PlainGrid points(1, vector<double>(samples + 1));
+    for (uint32_t s = 0; s <= samples; s++) {
+        points[0][s] = input.lo + (input.hi - input.lo) * s / samples;
+    }
+    vector<double> values = Reference(points)[0];
+    auto [lo, hi] = minmax_element(values.begin(), values.end());
+    return {*lo, *hi};
+}
+
+Pipeline& Pipeline::Add(shared_ptr<Layer> layer) {
+    layers.push_back(move(layer));
+    return *this;
+}
+
+uint32_t Pipeline::Depth() const {
+    uint32_t depth = 0;
+    for (const auto& layer : layers) {
+        depth += layer->Depth();
+    }
+    return depth;
+}
+
+void Pipeline::EnableBootstrapping(BootstrapConfig config) {
+    bootstrap = move(config);
+}
+
+uint32_t Pipeline::MultDepth() const {
+    if (!bootstrap) {
+        return Depth();
+    }
+    return bootstrap->levelsAfterBootstrap + FHECKKSRNS::GetBootstrapDepth(bootstrap->levelBudget, UNIFORM_TERNARY);
+}
+
+vector<size_t> Pipeline::BootstrapPlan() const {
+    vector<size_t> plan;
+    if (!bootstrap) {
+        return plan;
+    }
+    uint32_t remaining = MultDepth();
+    for (size_t i = 0; i < layers.size(); i++) {
+        uint32_t depth = layers[i]->Depth();
+        if (depth > bootstrap->levelsAfterBootstrap) {
+            throw invalid_argument("Pipeline: layer " + layers[i]->Name() + " needs " + to_string(depth) +
+                                   " levels but bootstrapping only provides " +
+                                   to_string(bootstrap->levelsAfterBootstrap));
+        }
+        if (depth > remaining) {
+            plan.push_back(i);
+            remaining = bootstrap->levelsAfterBootstrap;
+        }
+        remaining -= depth;
+    }
+    return plan;
+}
+
+CCParams<CryptoContextCKKSRNS> Pipeline::Parameters(uint32_t scaleModSize, uint32_t batchSize) const {
+    CCParams<CryptoContextCKKSRNS> parameters = makeParameters(MultDepth(), scaleModSize, batchSize);
+    if (bootstrap) {
+        parameters.SetSecretKeyDist(UNIFORM_TERNARY);
+        parameters.SetFirstModSize(60);
+    }
+    return parameters;
+}
+
+void Pipeline::PrepareBootstrapping(const CryptoContext<DCRTPoly>& cc, const PrivateKey<DCRTPoly>& secretKey,
+                                    uint32_t numSlots) const {
+    if (!bootstrap) {
+        return;
+    }
+    cc->Enable(ADVANCEDSHE);
+    cc->Enable(FHE);
+    cc->EvalBootstrapSetup(bootstrap->levelBudget, {0, 0}, numSlots);
+    cc->EvalBootstrapKeyGen(secretKey, numSlots);
+}
+
+vector<CiphertextGrid> Pipeline::Run(const CryptoContext<DCRTPoly>& cc, const CiphertextGrid& input,
+                                     vector<StageReport>* reports, RotationKeyCache* rotationKeys) const {
+    if (rotationKeys && bootstrap) {
+        throw invalid_argument("Pipeline: a rotation key cache cannot be combined with bootstrapping");
+    }
+    vector<size_t> plan = BootstrapPlan();
+    const uint32_t batchSize = cc->GetEncodingParams()->GetBatchSize();
+    auto nextBootstrap = plan.begin();
+    const uint32_t multDepth = MultDepth();
+
+    vector<CiphertextGrid> stages;
+    stages.reserve(layers.size());
+    const CiphertextGrid* current = &input;
+    for (size_t i = 0; i < layers.size(); i++) {
+        FHE_STAGE(layers[i]->Name());
+        auto start = chrono::steady_clock::now();
+        StageReport report;
+        report.layer = layers[i]->Name();
+        uint32_t usedBefore = levelsUsed((*current)[0][0]);
+        if (rotationKeys) {
+            const GridShape shape = {current->size(), (*current)[0].size()};
+            rotationKeys->Acquire(layers[i]->RotationIndices(batchSize, shape));
+            if (i + 1 < layers.size()) {
+                rotationKeys->Prefetch(layers[i + 1]->RotationIndices(batchSize, layers[i]->OutputShape(shape)));
+            }
+        }
+        if (nextBootstrap != plan.end() && *nextBootstrap == i) {
+            CiphertextGrid refreshed = *current;
+            for (auto& row : refreshed) {
+                for (auto& ct : row) {
+                    ct = FHE_OP(EvalBootstrap, cc->EvalBootstrap(ct));
+                }
+            }
+            usedBefore = levelsUsed(refreshed[0][0]);
+            report.bootstrapped = true;
+            stages.push_back(layers[i]->Forward(cc, refreshed));
+            ++nextBootstrap;
+        } else {
+            stages.push_back(layers[i]->Forward(cc, *current));
+        }
+        current = &stages.back();
+
+        if (reports) {
+            report.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            uint32_t usedAfter = levelsUsed((*current)[0][0]);
+            report.levelsConsumed = usedAfter - usedBefore;
+            report.levelsRemaining = usedAfter < multDepth ? multDepth - usedAfter : 0;
+            reports->push_back(report);
+        }
+    }
+    return stages;
+}
+
+vector<PlainGrid> Pipeline::Reference(const PlainGrid& input) const {
+    vector<PlainGrid> stages;
+    stages.reserve(layers.size());
+    const PlainGrid* current = &input;
+    for (const auto& layer : layers) {
+        stages.push_back(layer->Reference(*current));
+        current = &stages.back();
+    }
+    return stages;
+}
+
+vector<int32_t> Pipeline::RotationIndices(uint32_t batchSize, const GridShape& input) const {
+    set<int32_t> indices;
+    GridShape shape = input;
+    for (const auto& layer : layers) {
+        for (int32_t index : layer->RotationIndices(batchSize, shape)) {
+            indices.insert(index);
+        }
+        shape = layer->OutputShape(shape);
+    }
+    return vector<int32_t>(indices.begin(), indices.end());
+}
+
+vector<Range> Pipeline::Ranges(const Range& input) const {
+    vector<Range> ranges;
+    ranges.reserve(layers.size());
+    Range current = input;
+    for (const auto& layer : layers) {
+        current = layer->OutputRange(current);
+        ranges.push_back(current);
+    }
+    return ranges;
+}
+
+vector<Range> Pipeline::FoldNormalization(const Range& input) {
+    Range current = input;
+    for (size_t i = 0; i < layers.size(); i++) {
+        auto activation = dynamic_pointer_cast<PolynomialActivationLayer>(layers[i]);
+        auto linear = i > 0 ? dynamic_pointer_cast<LinearLayer>(layers[i - 1]) : nullptr;
+        if (activation && activation->Target() && linear && current.hi > current.lo) {
+            // `current` is still the un-normalized output range of the linear layer.
+            const double center = (current.lo + current.hi) / 2.0;
+            const double halfWidth = (current.hi - current.lo) / 2.0;
+            linear->FoldAffine(1.0 / halfWidth, -center / halfWidth);
+            activation->Fit(current);
+            current = {-1.0, 1.0};
+        }
+        current = layers[i]->OutputRange(current);
+    }
+    // Recompute from scratch so the reported ranges reflect the folded weights.
+    return Ranges(input);
+}
+
+uint32_t levelsUsed(const Ciphertext<DCRTPoly>& ciphertext) {
+    return static_cast<uint32_t>(ciphertext->GetLevel() + ciphertext->GetNoiseScaleDeg() - 1);
+}
+
+CCParams<CryptoContextCKKSRNS> ckksParameters(uint32_t multDepth, uint32_t scaleModSize, uint32_t batchSize) {
+    CCParams<CryptoContextCKKSRNS> parameters;
+    parameters.SetMultiplicativeDepth(multDepth);
+    parameters.SetScalingModSize(scaleModSize);
+    parameters.SetBatchSize(batchSize);
+    return parameters;
+}
+
+CCParams<CryptoContextCKKSRNS> makeParameters(uint32_t multDepth, uint32_t scaleModSize, uint32_t batchSize,
+                                              double maxMagnitude) {
+    // Like chooseParameters(): the scale, the magnitude and 10 bits for the
+    // noise must fit the modulus left at the end.
+    const uint32_t firstModSize = 60;
+    const uint32_t needed = scaleModSize + static_cast<uint32_t>(ceil(log2(max(1.0, maxMagnitude)))) + 10;
+    const uint32_t spareLevels = needed > firstModSize ? (needed - firstModSize + scaleModSize - 1) / scaleModSize : 0;
+    return ckksParameters(multDepth + spareLevels, scaleModSize, batchSize);
+}
+
+}  // namespace fhe
@@ -0,0 +1,278 @@
+#pragma once
+
+#include "encrypted_matrix.h"
+#include "openfhe.h"
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace fhe {
+
+class RotationKeyCache;
+
+// Closed interval of plaintext values.
+struct Range {
+    double lo;
+    double hi;
+};
+
+// Rows x columns of a ciphertext grid.
+struct GridShape {
+    size_t rows = 0;
+    size_t cols = 0;
+};
+
+// One stage of an encrypted pipeline.
+class Layer {
+public:
+    virtual ~Layer() = default;
+
+    virtual std::string Name() const = 0;
+
+    // Multiplicative levels consumed by Forward().
+    virtual uint32_t Depth() const = 0;
+
+    virtual CiphertextGrid Forward(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                                   const CiphertextGrid& input) const = 0;
+
+    // Plaintext counterpart of Forward(), used to compute expected results.
+    virtual PlainGrid Reference(const PlainGrid& input) const = 0;
+
+    // Range of the outputs given the range of every input element.
+    virtual Range OutputRange(const Range& input) const = 0;
+
+    // Shape of the grid Forward() returns for an input of shape `input`.
+    virtual GridShape OutputShape(const GridShape& input) const { return input; }
+
+    // Rotation keys Forward() needs for an input grid of shape `input` in a
+    // context with the given batch size.
+    virtual std::vector<int32_t> RotationIndices(uint32_t /*batchSize*/, const GridShape& /*input*/) const {
+        return {};
+    }
+};
+
+// Layer with plaintext weights whose output can absorb an affine map
+// y -> scale * y + shift at no depth cost.
+class LinearLayer : public Layer {
+public:
+    virtual void FoldAffine(double scale, double shift) = 0;
+};
+
+// Valid (no padding), stride 1 convolution with a plaintext kernel and bias.
+class Conv2DLayer : public LinearLayer {
+public:
+    explicit Conv2DLayer(PlainGrid kernel, double bias = 0.0);
+
+    std::string Name() const override { return "conv2d"; }
+    uint32_t Depth() const override { return 1; }
+    CiphertextGrid Forward(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                           const CiphertextGrid& input) const override;
+    PlainGrid Reference(const PlainGrid& input) const override;
+    Range OutputRange(const Range& input) const override;
+    GridShape OutputShape(const GridShape& input) const override;
+    void FoldAffine(double scale, double shift) override;
+
+    const PlainGrid& Kernel() const { return kernel; }
+    double Bias() const { return bias; }
+
+private:
+    PlainGrid kernel;
+    double bias;
+};
+
+// Fully connected layer y = W x + b with plaintext W (outputs x inputs) and b.
+// Forward() returns y packed in a single ciphertext (y[j] in slot j).
+// A packed input (1x1 grid) goes through the diagonal method: one hoisted
+// rotation and one plaintext product per non-zero cyclic diagonal of W. A
+// grid of `inputs` scalar ciphertexts is multiplied column by column instead,
+// which needs no rotations. The bias is a plaintext add and costs no level.
+class DenseLayer : public LinearLayer {
+public:
+    DenseLayer(PlainGrid weights, std::vector<double> bias);
+
+    std::string Name() const override { return "dense"; }
+    uint32_t Depth() const override { return 1; }
+    CiphertextGrid Forward(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                           const CiphertextGrid& input) const override;
+    // Flattens the input row by row and returns a 1 x outputs grid.
+    PlainGrid Reference(const PlainGrid& input) const override;
+    Range OutputRange(const Range& input) const override;
+    GridShape OutputShape(const GridShape& /*input*/) const override { return {1, 1}; }
+    void FoldAffine(double scale, double shift) override;
+    // The diagonals' rotations for a packed 1x1 input, none for scalar cells.
+    std::vector<int32_t> RotationIndices(uint32_t batchSize, const GridShape& input) const override;
+
+    size_t Inputs() const { return weights[0].size(); }
+    size_t Outputs() const { return weights.size(); }
+
+private:
+    PlainGrid weights;
+    std::vector<double> bias;
+};
+
+// Non-overlapping average pooling over size x size windows.
+class AvgPool2DLayer : public LinearLayer {
+public:
+    explicit AvgPool2DLayer(uint32_t size);
+
+    std::string Name() const override { return "avgpool"; }
+    // The window sum is free; only the 1/size^2 factor costs a level.
+    uint32_t Depth() const override { return scale == 1.0 ? 0 : 1; }
+    CiphertextGrid Forward(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                           const CiphertextGrid& input) const override;
+    PlainGrid Reference(const PlainGrid& input) const override;
+    Range OutputRange(const Range& input) const override;
+    GridShape OutputShape(const GridShape& input) const override;
+    void FoldAffine(double scale, double shift) override;
+
+private:
+    uint32_t size;
+    double scale;
+    double shift = 0.0;
+};
+
+// Element-wise polynomial sum_k coefficients[k] * x^k.
+class PolynomialActivationLayer : public Layer {
+public:
+    PolynomialActivationLayer(std::string name, std::vector<double> coefficients);
+
+    // Degree-`degree` Chebyshev approximation of `target`, initially on [-1, 1].
+    // Pipeline::FoldNormalization() refits it to the range it actually sees.
+    PolynomialActivationLayer(std::string name, std::function<double(double)> target, uint32_t degree);
+
+    std::string Name() const override { return name; }
+    uint32_t Depth() const override;
+    CiphertextGrid Forward(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                           const CiphertextGrid& input) const override;
+    PlainGrid Reference(const PlainGrid& input) const override;
+    Range OutputRange(const Range& input) const override;
+
+    // Refits the polynomial in t in [-1, 1] to target(center + halfWidth * t)
+    // over `domain`, i.e. for inputs already normalized to [-1, 1].
+    void Fit(const Range& domain);
+
+    const std::vector<double>& Coefficients() const { return coefficients; }
+    const std::function<double(double)>& Target() const { return target; }
+    const Range& Domain() const { return domain; }
+
+private:
+    std::string name;
+    std::vector<double> coefficients;
+    std::function<double(double)> target;
+    uint32_t degree = 0;
+    Range domain = {-1.0, 1.0};
+};
+
+// CKKS bootstrapping settings for pipelines deeper than the modulus chain.
+// Bootstrapping is only accurate for slot values roughly within [-1, 1].
+struct BootstrapConfig {
+    // Level budget for the CoeffsToSlots and SlotsToCoeffs steps.
+    std::vector<uint32_t> levelBudget = {4, 4};
+    // Levels left for the layers after each bootstrap.
+    uint32_t levelsAfterBootstrap = 10;
+};
+
+// Per-stage measurements collected by Pipeline::Run().
+struct StageReport {
+    std::string layer;
+    double milliseconds = 0.0;
+    // Levels consumed by the stage, measured on the first output ciphertext.
+    uint32_t levelsConsumed = 0;
+    // Levels left after the stage.
+    uint32_t levelsRemaining = 0;
+    bool bootstrapped = false;
+};
+
+// Ordered chain of layers sharing one CryptoContext. Each stage consumes the
+// previous stage's ciphertexts directly, and the depth budget is the sum of
+// the stages rather than the worst case of each one.
+class Pipeline {
+public:
+    Pipeline& Add(std::shared_ptr<Layer> layer);
+
+    // Sum of the layer depths.
+    uint32_t Depth() const;
+
+    // Turns on automatic bootstrapping: Run() refreshes the ciphertexts before
+    // any layer whose depth exceeds the levels left.
+    void EnableBootstrapping(BootstrapConfig config = {});
+    bool BootstrappingEnabled() const { return bootstrap.has_value(); }
+
+    // Multiplicative depth the context must provide: Depth() without
+    // bootstrapping, otherwise the post-bootstrap budget plus the depth of
+    // bootstrapping itself.
+    uint32_t MultDepth() const;
+
+    // Indices of the layers that Run() precedes with a bootstrap, assuming
+    // freshly encrypted inputs. Throws if a layer needs more levels than
+    // bootstrapping can provide.
+    std::vector<size_t> BootstrapPlan() const;
+
+    lbcrypto::CCParams<lbcrypto::CryptoContextCKKSRNS> Parameters(uint32_t scaleModSize, uint32_t batchSize) const;
+
+    // Enables FHE and generates the bootstrapping keys. No-op when
+    // bootstrapping is disabled. Call after KeyGen().
+    void PrepareBootstrapping(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                              const lbcrypto::PrivateKey<lbcrypto::DCRTPoly>& secretKey, uint32_t numSlots) const;
+
+    // Runs every layer in order and returns the output of each stage. When
+    // `reports` is given, one StageReport per layer is appended to it. With
+    // `rotationKeys`, each layer's rotation keys are acquired from the cache
+    // before it runs and the next layer's are prefetched meanwhile; the cache
+    // then owns the context's rotation keys, so bootstrapping must be off.
+    std::vector<CiphertextGrid> Run(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                                    const CiphertextGrid& input, std::vector<StageReport>* reports = nullptr,
+                                    RotationKeyCache* rotationKeys = nullptr) const;
+
+    std::vector<PlainGrid> Reference(const PlainGrid& input) const;
+
+    // Union of the rotation keys the layers need for an input grid of shape
+    // `input`, following the grid through every layer.
+    std::vector<int32_t> RotationIndices(uint32_t batchSize, const GridShape& input) const;
+
+    // Output range of every stage for inputs in `input`.
+    std::vector<Range> Ranges(const Range& input) const;
+
+    // Range-normalization mode: for every activation with a target function
+    // that follows a linear layer, folds the map of the linear layer's output
+    // range onto [-1, 1] into that layer's weights and refits the activation
+    // to the original range. Costs no extra level. Returns the new ranges.
+    std::vector<Range> FoldNormalization(const Range& input);
+
+    const std::vector<std::shared_ptr<Layer>>& Layers() const { return layers; }
+
+private:
+    std::vector<std::shared_ptr<Layer>> layers;
+    std::optional<BootstrapConfig> bootstrap;
+};
+
+// Levels a ciphertext has used, counting a pending rescale as used.
+uint32_t levelsUsed(const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& ciphertext);
+
+// CKKS parameters with exactly this depth, scale and batch size, for callers
+// that size the first modulus themselves.
+lbcrypto::CCParams<lbcrypto::CryptoContextCKKSRNS> ckksParameters(uint32_t multDepth, uint32_t scaleModSize,
+                                                                  uint32_t batchSize);
+
+// CKKS parameters sized for a planned depth and for results of magnitude up
+// to `maxMagnitude`. A result decrypts at the level it ends on, so values too
+// large for the 60-bit first modulus at this scale get spare levels on top.
+lbcrypto::CCParams<lbcrypto::CryptoContextCKKSRNS> makeParameters(uint32_t multDepth, uint32_t scaleModSize,
+                                                                  uint32_t batchSize, double maxMagnitude = 1.0);
+
+// BFV (Scheme = CryptoContextBFVRNS) or BGV (CryptoContextBGVRNS) parameters
+// for exact integer arithmetic mod `plaintextModulus`. Batching needs a prime
+// t = 1 mod 2 * ring dimension; 65537 suits ring dimensions up to 2^15. Unlike
+// CKKS, the modulus chain only has to absorb the noise, not a scaling factor.
+template <typename Scheme>
+lbcrypto::CCParams<Scheme> makeIntegerParameters(uint32_t multDepth, uint64_t plaintextModulus, uint32_t batchSize) {
+    lbcrypto::CCParams<Scheme> parameters;
+    parameters.SetMultiplicativeDepth(multDepth);
+    parameters.SetPlaintextModulus(plaintextModulus);
+    parameters.SetBatchSize(batchSize);
+    return parameters;
+}
+
+}  // namespace fhe
@@ -0,0 +1,137 @@
+#include "precision.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+using namespace lbcrypto;
+using namespace std;
+
+namespace fhe {
+
+namespace {
+
+// Precision reported for an exact match: the double mantissa.
+const double maxPrecisionBits = 52.0;
+
+double precisionBits(double error) {
+    return error > 0.0 ? min(maxPrecisionBits, -log2(error)) : maxPrecisionBits;
+}
+
+}  // namespace
+
+PrecisionTracker::PrecisionTracker(uint32_t multDepth) : multDepth(multDepth) {
+    Profiler::Instance().SetObserver(
+        [this](Op op, const Ciphertext<DCRTPoly>& ciphertext) { Observe(op, ciphertext); });
+}
+
+PrecisionTracker::~PrecisionTracker() {
+    Profiler::Instance().SetObserver(nullptr);
+}
+
+StagePrecision& PrecisionTracker::StageEntry(const string& stage) {
+    for (auto& entry : stages) {
+        if (entry.stage == stage) {
+            return entry;
+        }
+    }
+    StagePrecision entry;
+    entry.stage = stage;
+    entry.minLevelsRemaining = multDepth;
+    entry.minScaleBits = numeric_limits<double>::infinity();
+    entry.precisionBits = numeric_limits<double>::quiet_NaN();
+    stages.push_back(entry);
+    return stages.back();
+}
+
+void PrecisionTracker::Observe(Op op, const Ciphertext<DCRTPoly>& ciphertext) {
+    CiphertextState state;
+    state.op = op;
+    state.stage = Profiler::Instance().CurrentStage();
+    state.levelsUsed = levelsUsed(ciphertext);
+    state.levelsRemaining = state.levelsUsed < multDepth ? multDepth - state.levelsUsed : 0;
+    state.scaleBits = log2(ciphertext->GetScalingFactor());
+
+    lock_guard<mutex> lock(statesMutex);
+    StagePrecision& entry = StageEntry(state.stage.empty() ? "(none)" : state.stage);
+    entry.minLevelsRemaining = min(entry.minLevelsRemaining, state.levelsRemaining);
+    entry.minScaleBits = min(entry.minScaleBits, state.scaleBits);
+    states.push_back(move(state));
+}
+
+void PrecisionTracker::Measure(const CryptoContext<DCRTPoly>& cc, const PrivateKey<DCRTPoly>& secretKey,
+                               const string& stage, const CiphertextGrid& actual, const PlainGrid& expected) {
+    if (actual.empty() || expected.empty()) {
+        throw invalid_argument("PrecisionTracker: empty stage output");
+    }
+    const size_t cells = expected.size() * expected[0].size();
+    PlainGrid decrypted;
+    if (actual.size() == 1 && actual[0].size() == 1 && cells > 1) {
+        vector<double> packed = decryptPacked(cc, secretKey, actual[0][0], cells);
+        for (size_t i = 0; i < expected.size(); i++) {
+            auto row = packed.begin() + i * expected[0].size();
+            decrypted.emplace_back(row, row + expected[0].size());
+        }
+    } else {
+        decrypted = decryptGrid(cc, secretKey, actual);
+    }
+    if (decrypted.size() != expected.size() || decrypted[0].size() != expected[0].size()) {
+        throw invalid_argument("PrecisionTracker: stage " + stage + " does not match the reference shape");
+    }
+
+    double maxError = 0.0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        for (size_t j = 0; j < expected[i].size(); j++) {
+            maxError = max(maxError, abs(decrypted[i][j] - expected[i][j]));
+        }
+    }
+    const uint32_t used = levelsUsed(actual[0][0]);
+
+    lock_guard<mutex> lock(statesMutex);
+    StagePrecision& entry = StageEntry(stage);
+    entry.maxError = max(entry.maxError, maxError);
+    entry.precisionBits = isnan(entry.precisionBits) ? precisionBits(maxError)
+                                                     : min(entry.precisionBits, precisionBits(maxError));
+    entry.minLevelsRemaining = min(entry.minLevelsRemaining, used < multDepth ? multDepth - used : 0);
+    entry.minScaleBits = min(entry.minScaleBits, log2(actual[0][0]->GetScalingFactor()));
+}
+
+void PrecisionTracker::MeasureRun(const CryptoContext<DCRTPoly>& cc, const PrivateKey<DCRTPoly>& secretKey,
+                                  const Pipeline& pipeline, const PlainGrid& input,
+                                  const vector<CiphertextGrid>& stages) {
+    vector<PlainGrid> expected = pipeline.Reference(input);
+    if (stages.size() != expected.size()) {
+        throw invalid_argument("PrecisionTracker: expected " + to_string(expected.size()) + " stage outputs, got " +
+                               to_string(stages.size()));
+    }
+    for (size_t i = 0; i < stages.size(); i++) {
+        Measure(cc, secretKey, pipeline.Layers()[i]->Name(), stages[i], expected[i]);
+    }
+}
+
+vector<StagePrecision> PrecisionTracker::Stages() const {
+    lock_guard<mutex> lock(statesMutex);
+    return stages;
+}
+
+void PrecisionTracker::Report(ostream& out) const {
+    vector<StagePrecision> entries = Stages();
+    uint32_t minLevels = multDepth;
+    double worstBits = maxPrecisionBits;
+    out << left << setw(12) << "stage" << setw(14) << "levels left" << setw(12) << "scale bits" << setw(16)
+        << "precision bits" << "max error" << endl;
+    for (const auto& entry : entries) {
+        out << setw(12) << entry.stage << setw(14) << entry.minLevelsRemaining << setw(12) << entry.minScaleBits
+            << setw(16) << entry.precisionBits << entry.maxError << endl;
+        minLevels = min(minLevels, entry.minLevelsRemaining);
+        if (!isnan(entry.precisionBits)) {
+            worstBits = min(worstBits, entry.precisionBits);
+        }
+    }
+    out << right;
+    out << "Minimum levels left: " << minLevels << " of " << multDepth << " | worst precision: " << worstBits
+        << " bits" << endl;
+}
+
+}  // namespace fhe
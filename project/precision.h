@@ -0,0 +1,73 @@
+#pragma once
+
+#include "instrumentation.h"
+#include "pipeline.h"
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace fhe {
+
+// Level and scaling factor of a ciphertext right after an op produced it.
+struct CiphertextState {
+    Op op;
+    std::string stage;
+    uint32_t levelsUsed = 0;
+    uint32_t levelsRemaining = 0;
+    double scaleBits = 0.0;
+};
+
+// Worst case of one stage over everything the tracker saw.
+struct StagePrecision {
+    std::string stage;
+    uint32_t minLevelsRemaining = 0;
+    double minScaleBits = 0.0;
+    // -log2 of the largest error against the plaintext reference; NaN until
+    // the stage output has been measured.
+    double precisionBits = 0.0;
+    double maxError = 0.0;
+};
+
+// Debug-mode tracker for sizing multDepth and scaleModSize. While alive it
+// records the level and scaling factor of every ciphertext an instrumented op
+// returns (needs FHE_INSTRUMENTATION), and Measure() decrypts stage outputs
+// to get the precision actually achieved.
+class PrecisionTracker {
+public:
+    explicit PrecisionTracker(uint32_t multDepth);
+    ~PrecisionTracker();
+    PrecisionTracker(const PrecisionTracker&) = delete;
+    PrecisionTracker& operator=(const PrecisionTracker&) = delete;
+
+    // Decrypts `actual` and compares it with `expected`. A 1x1 grid against a
+    // larger reference is read as a packed vector.
+    void Measure(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                 const lbcrypto::PrivateKey<lbcrypto::DCRTPoly>& secretKey, const std::string& stage,
+                 const CiphertextGrid& actual, const PlainGrid& expected);
+
+    // Measure() for every stage of a Pipeline::Run() result.
+    void MeasureRun(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                    const lbcrypto::PrivateKey<lbcrypto::DCRTPoly>& secretKey, const Pipeline& pipeline,
+                    const PlainGrid& input, const std::vector<CiphertextGrid>& stages);
+
+    // Every observation in order. Not synchronized, read once the ops are done.
+    const std::vector<CiphertextState>& States() const { return states; }
+
+    // One entry per stage, in first-seen order.
+    std::vector<StagePrecision> Stages() const;
+
+    // Stage table plus the overall minimum levels left and worst precision.
+    void Report(std::ostream& out) const;
+
+private:
+    StagePrecision& StageEntry(const std::string& stage);
+    void Observe(Op op, const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& ciphertext);
+
+    uint32_t multDepth;
+    mutable std::mutex statesMutex;
+    std::vector<CiphertextState> states;
+    std::vector<StagePrecision> stages;
+};
+
+}  // namespace fhe
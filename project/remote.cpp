@@ -0,0 +1,179 @@
+#include "remote.h"
+#include "cryptocontext-ser.h"
+#include "key/key-ser.h"
+#include "scheme/ckksrns/ckksrns-ser.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace lbcrypto;
+using namespace std;
+
+namespace fhe {
+
+namespace {
+
+const size_t socketBufferSize = 1 << 16;
+
+sockaddr_un socketAddress(const string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw invalid_argument("socket path too long: " + path);
+    }
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    return address;
+}
+
+}  // namespace
+
+SocketBuffer::SocketBuffer(int fd) : fd(fd), input(socketBufferSize), output(socketBufferSize) {
+    setg(input.data(), input.data(), input.data());
+    setp(output.data(), output.data() + output.size());
+}
+
+SocketBuffer::int_type SocketBuffer::underflow() {
+    ssize_t received;
+    do {
+        received = recv(fd, input.data(), input.size(), 0);
+    } while (received < 0 && errno == EINTR);
+    if (received <= 0) {
+        return traits_type::eof();
+    }
+    setg(input.data(), input.data(), input.data() + received);
+    return traits_type::to_int_type(input[0]);
+}
+
+SocketBuffer::int_type SocketBuffer::overflow(int_type c) {
+    if (!Flush()) {
+        return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int SocketBuffer::sync() {
+    return Flush() ? 0 : -1;
+}
+
+bool SocketBuffer::Flush() {
+    const char* data = pbase();
+    size_t remaining = pptr() - pbase();
+    while (remaining > 0) {
+        ssize_t sent = send(fd, data, remaining, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        remaining -= sent;
+    }
+    setp(output.data(), output.data() + output.size());
+    return true;
+}
+
+Connection::Connection(int fd) : fd(fd), readBuffer(fd), writeBuffer(fd), in(&readBuffer), out(&writeBuffer) {}
+
+Connection::~Connection() {
+    out.flush();
+    close(fd);
+}
+
+void Connection::CloseWrite() {
+    out.flush();
+    shutdown(fd, SHUT_WR);
+}
+
+void Connection::Shutdown() {
+    shutdown(fd, SHUT_RDWR);
+}
+
+Listener::Listener(const string& path) : path(path), fd(socket(AF_UNIX, SOCK_STREAM, 0)) {
+    if (fd < 0) {
+        throw runtime_error("Listener: socket() failed: " + string(strerror(errno)));
+    }
+    sockaddr_un address = socketAddress(path);
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 4) != 0) {
+        string error = strerror(errno);
+        close(fd);
+        throw runtime_error("Listener: cannot listen on " + path + ": " + error);
+    }
+}
+
+Listener::~Listener() {
+    close(fd);
+    unlink(path.c_str());
+}
+
+unique_ptr<Connection> Listener::Accept() {
+    int client;
+    do {
+        client = accept(fd, nullptr, nullptr);
+    } while (client < 0 && errno == EINTR);
+    if (client < 0) {
+        throw runtime_error("Listener: accept() failed: " + string(strerror(errno)));
+    }
+    return make_unique<Connection>(client);
+}
+
+unique_ptr<Connection> connectTo(const string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw runtime_error("connectTo: socket() failed: " + string(strerror(errno)));
+    }
+    sockaddr_un address = socketAddress(path);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        string error = strerror(errno);
+        close(fd);
+        throw runtime_error("connectTo: cannot connect to " + path + ": " + error);
+    }
+    return make_unique<Connection>(fd);
+}
+
+void sendEvalContext(ostream& out, const CryptoContext<DCRTPoly>& cc, const string& keyTag, bool rotationKeys) {
+    out << keyTag << '\n';
+    Serial::Serialize(cc, out, SerType::BINARY);
+    if (!CryptoContextImpl<DCRTPoly>::SerializeEvalMultKey(out, SerType::BINARY, keyTag)) {
+        throw runtime_error("sendEvalContext: no relinearization key for tag " + keyTag);
+    }
+    out.put(rotationKeys ? 1 : 0);
+    if (rotationKeys && !CryptoContextImpl<DCRTPoly>::SerializeEvalAutomorphismKey(out, SerType::BINARY, keyTag)) {
+        throw runtime_error("sendEvalContext: no rotation keys for tag " + keyTag);
+    }
+    out.flush();
+}
+
+CryptoContext<DCRTPoly> receiveEvalContext(istream& in, string* keyTag) {
+    string tag;
+    if (!getline(in, tag)) {
+        throw runtime_error("receiveEvalContext: missing key tag");
+    }
+    if (keyTag) {
+        *keyTag = tag;
+    }
+    CryptoContext<DCRTPoly> cc;
+    Serial::Deserialize(cc, in, SerType::BINARY);
+    if (!cc || !CryptoContextImpl<DCRTPoly>::DeserializeEvalMultKey(in, SerType::BINARY)) {
+        throw runtime_error("receiveEvalContext: cannot deserialize the context");
+    }
+    int rotationKeys = in.get();
+    if (rotationKeys == 1 && !CryptoContextImpl<DCRTPoly>::DeserializeEvalAutomorphismKey(in, SerType::BINARY)) {
+        throw runtime_error("receiveEvalContext: cannot deserialize the rotation keys");
+    }
+    cc->Enable(PKE);
+    cc->Enable(KEYSWITCH);
+    cc->Enable(LEVELEDSHE);
+    cc->Enable(ADVANCEDSHE);
+    return cc;
+}
+
+}  // namespace fhe
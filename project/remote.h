@@ -0,0 +1,80 @@
+#pragma once
+
+#include "openfhe.h"
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace fhe {
+
+// Buffered streambuf over a socket descriptor it does not own.
+class SocketBuffer : public std::streambuf {
+public:
+    explicit SocketBuffer(int fd);
+
+protected:
+    int_type underflow() override;
+    int_type overflow(int_type c) override;
+    int sync() override;
+
+private:
+    bool Flush();
+
+    int fd;
+    std::vector<char> input;
+    std::vector<char> output;
+};
+
+// Connected Unix-domain socket with independent read and write streams, so
+// one thread can receive while another sends.
+class Connection {
+public:
+    explicit Connection(int fd);
+    ~Connection();
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    std::istream& In() { return in; }
+    std::ostream& Out() { return out; }
+
+    // Flushes and shuts the write side down; the peer sees end of stream.
+    void CloseWrite();
+    // Shuts both directions down, waking a thread blocked receiving.
+    void Shutdown();
+
+private:
+    int fd;
+    SocketBuffer readBuffer;
+    SocketBuffer writeBuffer;
+    std::istream in;
+    std::ostream out;
+};
+
+// Listening socket at `path`, replacing any stale socket file.
+class Listener {
+public:
+    explicit Listener(const std::string& path);
+    ~Listener();
+    Listener(const Listener&) = delete;
+    Listener& operator=(const Listener&) = delete;
+
+    std::unique_ptr<Connection> Accept();
+
+private:
+    std::string path;
+    int fd;
+};
+
+std::unique_ptr<Connection> connectTo(const std::string& path);
+
+// The context and the relinearization and rotation keys tagged `keyTag`:
+// everything a server needs to evaluate, and nothing that decrypts. The tag
+// goes first, so the receiver can clear the keys it loaded once done.
+void sendEvalContext(std::ostream& out, const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                     const std::string& keyTag, bool rotationKeys);
+lbcrypto::CryptoContext<lbcrypto::DCRTPoly> receiveEvalContext(std::istream& in, std::string* keyTag = nullptr);
+
+}  // namespace fhe
@@ -0,0 +1,243 @@
+#include "rotation_key_cache.h"
+#include "mapped_file.h"
+#include "key/key-ser.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace lbcrypto;
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace fhe {
+
+namespace {
+
+const string keyPrefix = "rotation_";
+const string keySuffix = ".bin";
+
+}  // namespace
+
+RotationKeyCache::RotationKeyCache(const CryptoContext<DCRTPoly>& cc, string keyTag, string directory,
+                                   size_t budgetBytes)
+    : cc(cc), keyTag(move(keyTag)), directory(move(directory)), budgetBytes(budgetBytes) {
+    const auto& allKeys = CryptoContextImpl<DCRTPoly>::GetAllEvalAutomorphismKeys();
+    auto existing = allKeys.find(this->keyTag);
+    if (existing != allKeys.end() && existing->second && !existing->second->empty()) {
+        throw invalid_argument("RotationKeyCache: the context already holds automorphism keys for tag " +
+                               this->keyTag);
+    }
+    fs::create_directories(this->directory);
+}
+
+RotationKeyCache::~RotationKeyCache() {
+    if (prefetcher.joinable()) {
+        prefetcher.join();
+    }
+}
+
+set<RotationKeyCache::Index> RotationKeyCache::Indices(const vector<int32_t>& rotations) const {
+    set<Index> indices;
+    for (int32_t r : rotations) {
+        if (r != 0) {
+            indices.insert(cc->FindAutomorphismIndex(r));
+        }
+    }
+    return indices;
+}
+
+string RotationKeyCache::KeyPath(Index index) const {
+    return (fs::path(directory) / (keyPrefix + to_string(index) + keySuffix)).string();
+}
+
+void RotationKeyCache::Generate(const PrivateKey<DCRTPoly>& secretKey, const vector<int32_t>& rotations,
+                                ThreadPool* pool) {
+    WaitForPrefetch();
+    vector<Index> missing;
+    for (Index index : Indices(rotations)) {
+        if (!sizes.count(index)) {
+            missing.push_back(index);
+        }
+    }
+    vector<size_t> written(missing.size());
+    forEachIndex(pool, missing.size(), [&](size_t i) {
+        const Index index = missing[i];
+        auto keyMap = cc->GetScheme()->EvalAutomorphismKeyGen(secretKey, {index});
+        // Written under a temporary name and renamed, so a crash never leaves a partial key.
+        const string path = KeyPath(index);
+        const string staging = path + ".tmp-" + to_string(getpid());
+        {
+            ofstream out(staging, ios::binary);
+            Serial::Serialize(keyMap->at(index), out, SerType::BINARY);
+            if (!out.flush()) {
+                throw runtime_error("RotationKeyCache: cannot write " + staging);
+            }
+        }
+        fs::rename(staging, path);
+        written[i] = fs::file_size(path);
+    });
+    for (size_t i = 0; i < missing.size(); i++) {
+        sizes[missing[i]] = written[i];
+    }
+}
+
+EvalKey<DCRTPoly> RotationKeyCache::ReadKey(Index index) const {
+    const string path = KeyPath(index);
+    MappedFile file(path);
+    MemoryBuffer buffer(file.Data(), file.Size());
+    istream in(&buffer);
+    EvalKey<DCRTPoly> key;
+    Serial::Deserialize(key, in, SerType::BINARY);
+    if (!key) {
+        throw runtime_error("RotationKeyCache: cannot deserialize " + path);
+    }
+    return key;
+}
+
+void RotationKeyCache::Insert(Index index, EvalKey<DCRTPoly> key) {
+    auto keyMap = make_shared<map<uint32_t, EvalKey<DCRTPoly>>>();
+    (*keyMap)[index] = move(key);
+    CryptoContextImpl<DCRTPoly>::InsertEvalAutomorphismKey(keyMap, keyTag);
+    lru.push_front(index);
+    resident[index] = lru.begin();
+    residentBytes += sizes.at(index);
+    stats.peakResidentBytes = max(stats.peakResidentBytes, residentBytes + stagedBytes);
+}
+
+void RotationKeyCache::Evict(Index index) {
+    CryptoContextImpl<DCRTPoly>::GetEvalAutomorphismKeyMap(keyTag).erase(index);
+    lru.erase(resident.at(index));
+    resident.erase(index);
+    residentBytes -= sizes.at(index);
+    stats.evictions++;
+}
+
+void RotationKeyCache::MakeRoom(size_t incoming, const set<Index>& keep) {
+    auto victim = lru.end();
+    while (residentBytes + stagedBytes + incoming > budgetBytes && victim != lru.begin()) {
+        --victim;
+        if (keep.count(*victim)) {
+            continue;
+        }
+        Index index = *victim;
+        ++victim;
+        Evict(index);
+    }
+}
+
+void RotationKeyCache::WaitForPrefetch() {
+    if (prefetcher.joinable()) {
+        prefetcher.join();
+    }
+    // Release the reservation of whatever a failed prefetch did not load.
+    stagedBytes = 0;
+    for (const auto& entry : staged) {
+        stagedBytes += sizes.at(entry.first);
+    }
+    if (prefetchError) {
+        exception_ptr error = prefetchError;
+        prefetchError = nullptr;
+        rethrow_exception(error);
+    }
+}
+
+void RotationKeyCache::Acquire(const vector<int32_t>& rotations) {
+    WaitForPrefetch();
+    const set<Index> needed = Indices(rotations);
+    for (Index index : needed) {
+        if (!sizes.count(index)) {
+            throw invalid_argument("RotationKeyCache: no key generated for automorphism index " + to_string(index));
+        }
+    }
+
+    size_t incoming = 0;
+    for (Index index : needed) {
+        auto it = resident.find(index);
+        if (it != resident.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            stats.hits++;
+        } else if (staged.count(index)) {
+            stats.prefetched++;
+        } else {
+            incoming += sizes.at(index);
+        }
+    }
+
+    // Prefetched keys become resident; their bytes were already reserved.
+    for (auto& [index, key] : staged) {
+        stagedBytes -= sizes.at(index);
+        Insert(index, move(key));
+    }
+    staged.clear();
+
+    MakeRoom(incoming, needed);
+    for (Index index : needed) {
+        if (!resident.count(index)) {
+            Insert(index, ReadKey(index));
+            stats.misses++;
+        }
+    }
+    inUse = needed;
+}
+
+void RotationKeyCache::Prefetch(const vector<int32_t>& rotations) {
+    WaitForPrefetch();
+    const set<Index> next = Indices(rotations);
+    vector<Index> missing;
+    size_t incoming = 0;
+    for (Index index : next) {
+        if (sizes.count(index) && !resident.count(index) && !staged.count(index)) {
+            missing.push_back(index);
+            incoming += sizes.at(index);
+        }
+    }
+    if (missing.empty()) {
+        return;
+    }
+
+    set<Index> keep = inUse;
+    keep.insert(next.begin(), next.end());
+    MakeRoom(incoming, keep);
+    vector<Index> load;
+    for (Index index : missing) {
+        if (residentBytes + stagedBytes + sizes.at(index) <= budgetBytes) {
+            load.push_back(index);
+            stagedBytes += sizes.at(index);
+        }
+    }
+    if (load.empty()) {
+        return;
+    }
+    stats.peakResidentBytes = max(stats.peakResidentBytes, residentBytes + stagedBytes);
+
+    prefetcher = thread([this, load] {
+        try {
+            for (Index index : load) {
+                staged[index] = ReadKey(index);
+            }
+        } catch (...) {
+            prefetchError = current_exception();
+        }
+    });
+}
+
+size_t RotationKeyCache::StoredBytes() const {
+    size_t total = 0;
+    for (const auto& entry : sizes) {
+        total += entry.second;
+    }
+    return total;
+}
+
+size_t RotationKeyCache::ResidentBytes() const {
+    return residentBytes;
+}
+
+RotationKeyStats RotationKeyCache::Stats() const {
+    return stats;
+}
+
+}  // namespace fhe
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "openfhe.h"
+#include "thread_pool.h"
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fhe {
+
+struct RotationKeyStats {
+    // Keys already resident when asked for.
+    size_t hits = 0;
+    // Keys a prefetch had loaded in time.
+    size_t prefetched = 0;
+    // Keys loaded synchronously in Acquire().
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t peakResidentBytes = 0;
+};
+
+// Rotation keys kept on disk, one file per key, and made resident in the
+// context only while needed. Acquire() loads the keys a layer uses and evicts
+// the least recently used others to stay under the memory budget; Prefetch()
+// loads the next layer's keys on a background thread while the current one
+// runs. A layer whose own keys exceed the budget still gets all of them.
+//
+// The cache owns the automorphism keys of `keyTag` in OpenFHE's process-wide
+// key map: it refuses to start if that tag already has any, and nothing else
+// may generate, insert or clear keys under it while the cache lives (no
+// EvalRotateKeyGen(), EvalSumKeyGen() or bootstrapping keys for the same
+// secret key), since Acquire() and Prefetch() evict entries from it.
+//
+// The context's key map is only modified on the calling thread, in
+// Acquire() and Prefetch(); the background thread just reads and
+// deserializes files. Not thread-safe otherwise: one caller at a time.
+class RotationKeyCache {
+public:
+    // Keys live in `directory` and are tagged `keyTag` in the context. Key
+    // files already in the directory are not used; Generate() overwrites them.
+    RotationKeyCache(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc, std::string keyTag, std::string directory,
+                     size_t budgetBytes);
+    ~RotationKeyCache();
+    RotationKeyCache(const RotationKeyCache&) = delete;
+    RotationKeyCache& operator=(const RotationKeyCache&) = delete;
+
+    // Generates the keys for `rotations` and writes each to disk without
+    // making it resident. Keys this cache already generated are skipped. With a pool, every
+    // key is generated and written by its own task.
+    void Generate(const lbcrypto::PrivateKey<lbcrypto::DCRTPoly>& secretKey, const std::vector<int32_t>& rotations,
+                  ThreadPool* pool = nullptr);
+
+    // Makes every key for `rotations` resident. Waits for a running prefetch.
+    void Acquire(const std::vector<int32_t>& rotations);
+
+    // Starts loading the keys for `rotations` in the background, as far as
+    // the budget allows after evicting keys the current layer does not use.
+    void Prefetch(const std::vector<int32_t>& rotations);
+
+    // Serialized size of every generated key, and of the resident ones.
+    size_t StoredBytes() const;
+    size_t ResidentBytes() const;
+    RotationKeyStats Stats() const;
+
+private:
+    using Index = uint32_t;
+
+    std::set<Index> Indices(const std::vector<int32_t>& rotations) const;
+    std::string KeyPath(Index index) const;
+    lbcrypto::EvalKey<lbcrypto::DCRTPoly> ReadKey(Index index) const;
+    void Insert(Index index, lbcrypto::EvalKey<lbcrypto::DCRTPoly> key);
+    void Evict(Index index);
+    // Evicts unprotected keys, least recently used first, until `incoming`
+    // more bytes fit the budget or nothing is left to evict.
+    void MakeRoom(size_t incoming, const std::set<Index>& keep);
+    void WaitForPrefetch();
+
+    lbcrypto::CryptoContext<lbcrypto::DCRTPoly> cc;
+    std::string keyTag;
+    std::string directory;
+    size_t budgetBytes;
+
+    // Serialized size of every generated key, the estimate of its footprint.
+    std::map<Index, size_t> sizes;
+    // Resident keys, most recently used first.
+    std::list<Index> lru;
+    std::map<Index, std::list<Index>::iterator> resident;
+    size_t residentBytes = 0;
+    // The keys of the last Acquire(), never evicted by Prefetch().
+    std::set<Index> inUse;
+
+    // Filled by the prefetch thread and read only after it is joined;
+    // inserted into the context by the next Acquire(). The bytes are
+    // reserved when the prefetch starts.
+    std::map<Index, lbcrypto::EvalKey<lbcrypto::DCRTPoly>> staged;
+    size_t stagedBytes = 0;
+    std::thread prefetcher;
+    std::exception_ptr prefetchError;
+
+    RotationKeyStats stats;
+};
+
+}  // namespace fhe
@@ -0,0 +1,365 @@
+#include "sharded_matmul.h"
+#include "ciphertext_file.h"
+#include "kernels.h"
+#include "mapped_file.h"
+#include "remote.h"
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <spawn.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+extern char** environ;
+
+using namespace lbcrypto;
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace fhe {
+
+namespace {
+
+const char* contextFile = "context.bin";
+
+// Output block (I, J) summed over tiles [kBegin, kEnd) of the inner dimension.
+struct Shard {
+    uint32_t i;
+    uint32_t j;
+    uint32_t kBegin;
+    uint32_t kEnd;
+};
+
+string tileFile(const fs::path& directory, char matrix, uint32_t row, uint32_t col) {
+    return (directory / (string(1, matrix) + "_" + to_string(row) + "_" + to_string(col) + ".fhect")).string();
+}
+
+string partialFile(const fs::path& directory, const Shard& shard) {
+    return (directory / ("c_" + to_string(shard.i) + "_" + to_string(shard.j) + "_" + to_string(shard.kBegin) +
+                         ".fhect"))
+        .string();
+}
+
+string shardListFile(const fs::path& directory, uint32_t worker) {
+    return (directory / ("shards_" + to_string(worker) + ".txt")).string();
+}
+
+uint32_t tileCount(uint32_t size, uint32_t tile) {
+    return (size + tile - 1) / tile;
+}
+
+// Written under a temporary name, so a reader never sees half a file.
+void saveAtomically(const string& path, const EncryptedMatrix& matrix) {
+    saveMatrix(path + ".tmp", matrix);
+    fs::rename(path + ".tmp", path);
+}
+
+void addInPlace(const CryptoContext<DCRTPoly>& cc, EncryptedMatrix& sum, const EncryptedMatrix& term) {
+    vector<Ciphertext<DCRTPoly>> ciphertexts = sum.Ciphertexts();
+    for (size_t c = 0; c < ciphertexts.size(); c++) {
+        cc->EvalAddInPlace(ciphertexts[c], term.At(c));
+    }
+    sum = EncryptedMatrix(sum.GetPacking(), sum.Rows(), sum.Cols(), move(ciphertexts));
+}
+
+// Splits every output block's inner dimension into enough ranges to give all
+// workers something to do, then deals the shards out largest first to the
+// least loaded worker.
+vector<vector<Shard>> planShards(uint32_t rowTiles, uint32_t colTiles, uint32_t innerTiles, uint32_t workers) {
+    const uint32_t blocks = rowTiles * colTiles;
+    const uint32_t splits = min(innerTiles, max(1u, (workers + blocks - 1) / blocks));
+    vector<Shard> shards;
+    for (uint32_t i = 0; i < rowTiles; i++) {
+        for (uint32_t j = 0; j < colTiles; j++) {
+            for (uint32_t s = 0; s < splits; s++) {
+                shards.push_back({i, j, s * innerTiles / splits, (s + 1) * innerTiles / splits});
+            }
+        }
+    }
+    stable_sort(shards.begin(), shards.end(),
+                [](const Shard& x, const Shard& y) { return x.kEnd - x.kBegin > y.kEnd - y.kBegin; });
+
+    vector<vector<Shard>> assignment(min<size_t>(workers, shards.size()));
+    vector<uint32_t> load(assignment.size(), 0);
+    for (const Shard& shard : shards) {
+        size_t worker = min_element(load.begin(), load.end()) - load.begin();
+        assignment[worker].push_back(shard);
+        load[worker] += shard.kEnd - shard.kBegin;
+    }
+    return assignment;
+}
+
+string defaultWorkerPath() {
+    return (fs::read_symlink("/proc/self/exe").parent_path() / "fhe_shard_worker").string();
+}
+
+pid_t spawnWorker(const string& path, const vector<string>& args, uint32_t ompThreads) {
+    // The worker's environment, with its share of the cores for OpenMP.
+    vector<string> environment;
+    for (char** entry = environ; *entry; entry++) {
+        if (strncmp(*entry, "OMP_NUM_THREADS=", 16) != 0) {
+            environment.push_back(*entry);
+        }
+    }
+    environment.push_back("OMP_NUM_THREADS=" + to_string(ompThreads));
+
+    vector<char*> argv = {const_cast<char*>(path.c_str())};
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    vector<char*> envp;
+    for (auto& entry : environment) {
+        envp.push_back(entry.data());
+    }
+    envp.push_back(nullptr);
+
+    pid_t pid;
+    int error = posix_spawn(&pid, path.c_str(), nullptr, nullptr, argv.data(), envp.data());
+    if (error != 0) {
+        throw runtime_error("ShardedMatMul: cannot start " + path + ": " + strerror(error));
+    }
+    return pid;
+}
+
+}  // namespace
+
+TiledMatrix encryptTiled(const BatchEncryptor& encryptor, const PlainGrid& values, uint32_t tile, Packing packing) {
+    if (tile == 0) {
+        throw invalid_argument("encryptTiled: tile size must be positive");
+    }
+    TiledMatrix matrix;
+    matrix.rows = values.size();
+    matrix.cols = values.empty() ? 0 : values[0].size();
+    matrix.tile = tile;
+    const uint32_t rowTiles = tileCount(matrix.rows, tile);
+    const uint32_t colTiles = tileCount(matrix.cols, tile);
+
+    vector<PlainGrid> blocks;
+    for (uint32_t i = 0; i < rowTiles; i++) {
+        for (uint32_t j = 0; j < colTiles; j++) {
+            PlainGrid block;
+            for (uint32_t r = i * tile; r < min(matrix.rows, (i + 1) * tile); r++) {
+                block.emplace_back(values[r].begin() + j * tile,
+                                   values[r].begin() + min(matrix.cols, (j + 1) * tile));
+            }
+            blocks.push_back(move(block));
+        }
+    }
+    vector<EncryptedMatrix> encrypted = encryptor.EncryptAll(blocks, packing);
+    matrix.tiles.resize(rowTiles);
+    for (uint32_t i = 0; i < rowTiles; i++) {
+        for (uint32_t j = 0; j < colTiles; j++) {
+            matrix.tiles[i].push_back(move(encrypted[static_cast<size_t>(i) * colTiles + j]));
+        }
+    }
+    return matrix;
+}
+
+PlainGrid decryptTiled(const BatchDecryptor& decryptor, const TiledMatrix& matrix) {
+    PlainGrid values(matrix.rows, vector<double>(matrix.cols));
+    for (size_t i = 0; i < matrix.tiles.size(); i++) {
+        for (size_t j = 0; j < matrix.tiles[i].size(); j++) {
+            PlainGrid block = decryptor.Decrypt(matrix.tiles[i][j]);
+            for (size_t r = 0; r < block.size(); r++) {
+                copy(block[r].begin(), block[r].end(), values[i * matrix.tile + r].begin() + j * matrix.tile);
+            }
+        }
+    }
+    return values;
+}
+
+ShardedMatMul::ShardedMatMul(const CryptoContext<DCRTPoly>& cc, const string& keyTag, ShardOptions options)
+    : cc(cc), options(move(options)) {
+    if (this->options.workers == 0) {
+        throw invalid_argument("ShardedMatMul: needs at least one worker");
+    }
+    if (this->options.workerPath.empty()) {
+        this->options.workerPath = defaultWorkerPath();
+    }
+    static atomic<uint32_t> instances{0};
+    directory = (fs::path(this->options.workDir) /
+                 ("fhe_shards_" + to_string(getpid()) + "_" + to_string(instances++)))
+                    .string();
+    fs::create_directories(directory);
+
+    // Written once; every worker of every product maps this same file.
+    try {
+        ofstream out(fs::path(directory) / contextFile, ios::binary);
+        sendEvalContext(out, cc, keyTag, true);
+        if (!out) {
+            throw runtime_error("ShardedMatMul: cannot write the context to " + directory);
+        }
+    } catch (...) {
+        fs::remove_all(directory);
+        throw;
+    }
+}
+
+ShardedMatMul::~ShardedMatMul() {
+    error_code ignored;
+    fs::remove_all(directory, ignored);
+}
+
+TiledMatrix ShardedMatMul::Multiply(const TiledMatrix& a, const TiledMatrix& b) {
+    if (a.tile != b.tile || a.cols != b.rows) {
+        throw invalid_argument("ShardedMatMul: tile sizes or inner dimensions do not match");
+    }
+    if (a.tiles.empty() || b.tiles.empty() || a.tiles[0][0].GetPacking() != Packing::Rows ||
+        b.tiles[0][0].GetPacking() != Packing::Columns) {
+        throw invalid_argument("ShardedMatMul: expects A tiled in Rows packing and B in Columns packing");
+    }
+    const uint32_t rowTiles = a.tiles.size();
+    const uint32_t innerTiles = b.tiles.size();
+    const uint32_t colTiles = b.tiles[0].size();
+
+    const fs::path product = fs::path(directory) / ("product" + to_string(products++));
+    fs::create_directories(product);
+    for (uint32_t i = 0; i < rowTiles; i++) {
+        for (uint32_t k = 0; k < innerTiles; k++) {
+            saveAtomically(tileFile(product, 'a', i, k), a.tiles[i][k]);
+        }
+    }
+    for (uint32_t k = 0; k < innerTiles; k++) {
+        for (uint32_t j = 0; j < colTiles; j++) {
+            saveAtomically(tileFile(product, 'b', k, j), b.tiles[k][j]);
+        }
+    }
+
+    vector<vector<Shard>> assignment = planShards(rowTiles, colTiles, innerTiles, options.workers);
+    for (size_t w = 0; w < assignment.size(); w++) {
+        ofstream list(shardListFile(product, w));
+        for (const Shard& shard : assignment[w]) {
+            list << shard.i << " " << shard.j << " " << shard.kBegin << " " << shard.kEnd << "\n";
+        }
+        if (!list) {
+            throw runtime_error("ShardedMatMul: cannot write the shard list to " + product.string());
+        }
+    }
+
+    const uint32_t cores = max(1u, thread::hardware_concurrency());
+    const uint32_t ompThreads = max<uint32_t>(1, cores / assignment.size());
+    vector<pid_t> pids;
+    try {
+        for (size_t w = 0; w < assignment.size(); w++) {
+            pids.push_back(spawnWorker(options.workerPath,
+                                       {(fs::path(directory) / contextFile).string(), product.string(), to_string(w)},
+                                       ompThreads));
+        }
+    } catch (...) {
+        // Stop the workers already running before their directory goes away.
+        for (pid_t pid : pids) {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        fs::remove_all(product);
+        throw;
+    }
+    string failures;
+    for (size_t w = 0; w < pids.size(); w++) {
+        int status = 0;
+        if (waitpid(pids[w], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failures += " " + to_string(w);
+        }
+    }
+    if (!failures.empty()) {
+        fs::remove_all(product);
+        throw runtime_error("ShardedMatMul: workers" + failures + " failed");
+    }
+
+    // Reduce the partial sums of every output block.
+    TiledMatrix c;
+    c.rows = a.rows;
+    c.cols = b.cols;
+    c.tile = a.tile;
+    c.tiles.resize(rowTiles);
+    for (uint32_t i = 0; i < rowTiles; i++) {
+        for (uint32_t j = 0; j < colTiles; j++) {
+            optional<EncryptedMatrix> sum;
+            for (const auto& shards : assignment) {
+                for (const Shard& shard : shards) {
+                    if (shard.i != i || shard.j != j) {
+                        continue;
+                    }
+                    EncryptedMatrix partial = loadMatrix(partialFile(product, shard));
+                    if (!sum) {
+                        sum = move(partial);
+                    } else {
+                        addInPlace(cc, *sum, partial);
+                    }
+                }
+            }
+            c.tiles[i].push_back(move(*sum));
+        }
+    }
+    fs::remove_all(product);
+    return c;
+}
+
+void runShards(const string& contextPath, const string& productDirectory, uint32_t worker) {
+    CryptoContext<DCRTPoly> cc;
+    {
+        MappedFile file(contextPath);
+        MemoryBuffer buffer(file.Data(), file.Size());
+        istream in(&buffer);
+        cc = receiveEvalContext(in);
+    }
+
+    const fs::path product = productDirectory;
+    ifstream list(shardListFile(product, worker));
+    if (!list) {
+        throw runtime_error("runShards: no shard list for worker " + to_string(worker) + " in " + productDirectory);
+    }
+    vector<Shard> shards;
+    string line;
+    while (getline(list, line)) {
+        Shard shard;
+        istringstream fields(line);
+        if (fields >> shard.i >> shard.j >> shard.kBegin >> shard.kEnd) {
+            shards.push_back(shard);
+        }
+    }
+
+    // Tile A(i, k) is shared by every output block of row i, so it is read once
+    // and kept until the last shard using it is done; working row by row keeps
+    // only one row of tiles alive.
+    stable_sort(shards.begin(), shards.end(), [](const Shard& x, const Shard& y) { return x.i < y.i; });
+    map<pair<uint32_t, uint32_t>, uint32_t> uses;
+    for (const Shard& shard : shards) {
+        for (uint32_t k = shard.kBegin; k < shard.kEnd; k++) {
+            uses[{shard.i, k}]++;
+        }
+    }
+    map<pair<uint32_t, uint32_t>, EncryptedMatrix> aTiles;
+    for (const Shard& shard : shards) {
+        optional<EncryptedMatrix> sum;
+        for (uint32_t k = shard.kBegin; k < shard.kEnd; k++) {
+            const pair<uint32_t, uint32_t> key{shard.i, k};
+            auto a = aTiles.find(key);
+            if (a == aTiles.end()) {
+                a = aTiles.emplace(key, CiphertextReader(tileFile(product, 'a', shard.i, k)).ReadMatrix()).first;
+            }
+            EncryptedMatrix block =
+                matMul(cc, a->second, CiphertextReader(tileFile(product, 'b', k, shard.j)).ReadMatrix());
+            if (--uses[key] == 0) {
+                aTiles.erase(a);
+            }
+            if (!sum) {
+                sum = move(block);
+            } else {
+                addInPlace(cc, *sum, block);
+            }
+        }
+        saveAtomically(partialFile(product, shard), *sum);
+    }
+}
+
+}  // namespace fhe
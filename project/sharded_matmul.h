@@ -0,0 +1,69 @@
+#pragma once
+
+#include "batch_crypto.h"
+#include "encrypted_matrix.h"
+#include <string>
+#include <vector>
+
+namespace fhe {
+
+// Block matrix of encrypted tiles in one packing. Tile (I, J) holds rows
+// [I * tile, (I + 1) * tile) and columns [J * tile, (J + 1) * tile), clipped
+// at the edges.
+struct TiledMatrix {
+    uint32_t rows = 0;
+    uint32_t cols = 0;
+    uint32_t tile = 0;
+    std::vector<std::vector<EncryptedMatrix>> tiles;
+};
+
+// Encrypts all tiles in one parallel pass.
+TiledMatrix encryptTiled(const BatchEncryptor& encryptor, const PlainGrid& values, uint32_t tile, Packing packing);
+PlainGrid decryptTiled(const BatchDecryptor& decryptor, const TiledMatrix& matrix);
+
+struct ShardOptions {
+    // Worker processes to run at most.
+    uint32_t workers = 2;
+    // Where the context, keys and tiles are exchanged. On tmpfs they stay in
+    // shared memory.
+    std::string workDir = "/dev/shm";
+    // The fhe_shard_worker executable; empty means next to the running one.
+    std::string workerPath;
+};
+
+// Runs tiled matrix products C = A B in worker processes on this host, so
+// the work is not bound by one process's memory and allocator. The context
+// and evaluation keys are written once, and the tiles once per product. Every
+// worker maps them read-only, computes its share of the block products
+// A_IK B_KJ and writes the partial sums back. The coordinator then adds up
+// the partial sums of each output block. Each worker gets cores / workers
+// OpenMP threads.
+class ShardedMatMul {
+public:
+    // Needs the relinearization and EvalSum keys tagged `keyTag`.
+    ShardedMatMul(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc, const std::string& keyTag,
+                  ShardOptions options = {});
+    // Removes the exchange directory.
+    ~ShardedMatMul();
+    ShardedMatMul(const ShardedMatMul&) = delete;
+    ShardedMatMul& operator=(const ShardedMatMul&) = delete;
+
+    // A in Rows packing and B in Columns packing with the same tile size;
+    // the result is in Element packing.
+    TiledMatrix Multiply(const TiledMatrix& a, const TiledMatrix& b);
+
+    const std::string& Directory() const { return directory; }
+
+private:
+    lbcrypto::CryptoContext<lbcrypto::DCRTPoly> cc;
+    ShardOptions options;
+    std::string directory;
+    uint32_t products = 0;
+};
+
+// Worker side of ShardedMatMul: loads the evaluation context from
+// `contextPath` and computes the shards assigned to `worker` in the product
+// directory. This is all fhe_shard_worker does.
+void runShards(const std::string& contextPath, const std::string& productDirectory, uint32_t worker);
+
+}  // namespace fhe
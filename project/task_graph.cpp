@@ -0,0 +1,76 @@
+#include "task_graph.h"
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace fhe {
+
+TaskGraph::Task TaskGraph::Add(function<void()> work, const vector<Task>& dependencies) {
+    const Task task = tasks.size();
+    for (Task dependency : dependencies) {
+        if (dependency >= task) {
+            throw invalid_argument("TaskGraph: task " + to_string(task) + " depends on unknown task " +
+                                   to_string(dependency));
+        }
+    }
+    tasks.push_back({move(work), {}, static_cast<uint32_t>(dependencies.size())});
+    for (Task dependency : dependencies) {
+        tasks[dependency].successors.push_back(task);
+    }
+    return task;
+}
+
+void TaskGraph::Run(ThreadPool& pool) const {
+    if (tasks.empty()) {
+        return;
+    }
+    unique_ptr<atomic<uint32_t>[]> waiting(new atomic<uint32_t>[tasks.size()]);
+    for (size_t t = 0; t < tasks.size(); t++) {
+        waiting[t] = tasks[t].dependencies;
+    }
+    atomic<size_t> finished{0};
+    atomic<bool> failed{false};
+    mutex errorMutex;
+    exception_ptr error;
+
+    function<void(Task)> submit = [&](Task task) {
+        pool.Submit([&, task] {
+            if (!failed) {
+                try {
+                    tasks[task].work();
+                } catch (...) {
+                    lock_guard<mutex> lock(errorMutex);
+                    if (!error) {
+                        error = current_exception();
+                    }
+                    failed = true;
+                }
+            }
+            // Successors still run through the pool after a failure, as no-ops,
+            // so every task is accounted for before Run() returns.
+            for (Task successor : tasks[task].successors) {
+                if (--waiting[successor] == 0) {
+                    submit(successor);
+                }
+            }
+            finished++;
+        });
+    };
+    for (size_t t = 0; t < tasks.size(); t++) {
+        if (tasks[t].dependencies == 0) {
+            submit(t);
+        }
+    }
+
+    pool.WaitUntil([&] { return finished == tasks.size(); });
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+}  // namespace fhe
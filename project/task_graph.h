@@ -0,0 +1,36 @@
+#pragma once
+
+#include "thread_pool.h"
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace fhe {
+
+// Tasks with dependencies, run on a ThreadPool. A task starts as soon as
+// every task it depends on has finished, so independent ciphertext operations
+// run concurrently and idle workers steal whatever is ready.
+class TaskGraph {
+public:
+    using Task = size_t;
+
+    // Dependencies must have been added before.
+    Task Add(std::function<void()> work, const std::vector<Task>& dependencies = {});
+
+    size_t Size() const { return tasks.size(); }
+
+    // Runs every task once and waits for all of them. After a task throws,
+    // the remaining tasks are skipped and the first exception is rethrown.
+    void Run(ThreadPool& pool) const;
+
+private:
+    struct Node {
+        std::function<void()> work;
+        std::vector<Task> successors;
+        uint32_t dependencies = 0;
+    };
+
+    std::vector<Node> tasks;
+};
+
+}  // namespace fhe
@@ -0,0 +1,164 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <exception>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+namespace fhe {
+
+namespace {
+
+// Pool and deque of the calling thread when it is a worker.
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local uint32_t currentWorker = 0;
+
+}  // namespace
+
+ThreadPool::ThreadPool(uint32_t workers) {
+    const uint32_t cores = max(1u, thread::hardware_concurrency());
+    const uint32_t count = workers == 0 ? cores : workers;
+    const uint32_t ompThreads = max(1u, cores / count);
+    for (uint32_t i = 0; i < count; i++) {
+        deques.push_back(make_unique<Deque>());
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        this->workers.emplace_back([this, i, ompThreads] { Work(i, ompThreads); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::Submit(function<void()> task) {
+    const uint32_t target = currentPool == this ? currentWorker : nextDeque++ % deques.size();
+    {
+        // Counted before it is visible, so `queued` never drops below zero.
+        lock_guard<mutex> lock(wakeMutex);
+        queued++;
+    }
+    {
+        lock_guard<mutex> lock(deques[target]->mutex);
+        deques[target]->tasks.push_back(move(task));
+    }
+    wake.notify_all();
+}
+
+bool ThreadPool::RunOne(uint32_t self) {
+    function<void()> task;
+    for (size_t k = 0; k < deques.size() && !task; k++) {
+        Deque& deque = *deques[(self + k) % deques.size()];
+        lock_guard<mutex> lock(deque.mutex);
+        if (deque.tasks.empty()) {
+            continue;
+        }
+        if (k == 0) {
+            task = move(deque.tasks.back());
+            deque.tasks.pop_back();
+        } else {
+            task = move(deque.tasks.front());
+            deque.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    queued--;
+    task();
+    {
+        // Pairs with the predicate check in WaitUntil(), so no wakeup is lost.
+        lock_guard<mutex> lock(wakeMutex);
+    }
+    wake.notify_all();
+    return true;
+}
+
+void ThreadPool::Work(uint32_t index, uint32_t ompThreads) {
+#ifdef _OPENMP
+    omp_set_num_threads(ompThreads);
+#else
+    (void)ompThreads;
+#endif
+    currentPool = this;
+    currentWorker = index;
+    while (true) {
+        if (RunOne(index)) {
+            continue;
+        }
+        unique_lock<mutex> lock(wakeMutex);
+        wake.wait(lock, [&] { return stopping || queued > 0; });
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::WaitUntil(const function<bool()>& done) {
+    const bool worker = currentPool == this;
+    while (true) {
+        {
+            unique_lock<mutex> lock(wakeMutex);
+            wake.wait(lock, [&] { return done() || (worker && queued > 0); });
+            if (done()) {
+                return;
+            }
+        }
+        RunOne(currentWorker);
+    }
+}
+
+void ThreadPool::ParallelFor(size_t n, const function<void(size_t)>& f) {
+    if (n == 0) {
+        return;
+    }
+    // One task per worker, each pulling indices until none are left.
+    atomic<size_t> next{0};
+    const size_t taskCount = min<size_t>(n, workers.size());
+    atomic<size_t> running{taskCount};
+    mutex errorMutex;
+    exception_ptr error;
+
+    for (size_t t = 0; t < taskCount; t++) {
+        Submit([&] {
+            for (size_t i = next++; i < n; i = next++) {
+                try {
+                    f(i);
+                } catch (...) {
+                    lock_guard<mutex> lock(errorMutex);
+                    if (!error) {
+                        error = current_exception();
+                    }
+                    next = n;
+                }
+            }
+            running--;
+        });
+    }
+
+    WaitUntil([&] { return running == 0; });
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+void forEachIndex(ThreadPool* pool, size_t n, const function<void(size_t)>& f) {
+    if (pool) {
+        pool->ParallelFor(n, f);
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            f(i);
+        }
+    }
+}
+
+}  // namespace fhe
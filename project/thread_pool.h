@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fhe {
+
+// Work-stealing pool for coarse-grained FHE work. Every worker owns a deque:
+// it pushes and pops its own tasks at the back and, when it runs dry, steals
+// from the front of the others. OpenFHE parallelizes inside each primitive
+// with OpenMP, so every worker caps its own OpenMP team at cores / workers;
+// the total stays at one thread per core.
+class ThreadPool {
+public:
+    // 0 workers means one per hardware thread.
+    explicit ThreadPool(uint32_t workers = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32_t Size() const { return workers.size(); }
+
+    // Queues a task, which must not throw. Tasks submitted from a worker go on
+    // that worker's deque, others are spread over the workers.
+    void Submit(std::function<void()> task);
+
+    // Returns once done() holds. On a worker, runs queued tasks meanwhile, so
+    // tasks may wait on tasks they submitted without tying up a thread.
+    // done() is evaluated under the pool's lock and must only read state that
+    // tasks update before they finish.
+    void WaitUntil(const std::function<bool()>& done);
+
+    // Runs f(i) for every i in [0, n) on the workers and waits for all of
+    // them. Rethrows the first exception. May be nested inside a task.
+    void ParallelFor(size_t n, const std::function<void(size_t)>& f);
+
+private:
+    struct Deque {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    // Runs one task: the newest of worker `self`, else the oldest of another.
+    bool RunOne(uint32_t self);
+    void Work(uint32_t index, uint32_t ompThreads);
+
+    std::vector<std::unique_ptr<Deque>> deques;
+    std::vector<std::thread> workers;
+    std::atomic<uint32_t> nextDeque{0};
+    // Tasks queued but not yet started.
+    std::atomic<size_t> queued{0};
+    std::mutex wakeMutex;
+    // Signalled when a task is queued, and when one finishes.
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+// f(i) for every i in [0, n), on the pool if there is one, else in order on
+// the calling thread.
+void forEachIndex(ThreadPool* pool, size_t n, const std::function<void(size_t)>& f);
+
+}  // namespace fhe
@@ -0,0 +1,172 @@
+#include "tuning.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+using namespace lbcrypto;
+using namespace std;
+
+namespace fhe {
+
+namespace {
+
+// Largest log2(QP) per ring dimension for ternary secrets, from the
+// HomomorphicEncryption.org security standard.
+struct SecurityBound {
+    uint32_t ringDim;
+    uint32_t maxLogQP128;
+    uint32_t maxLogQP192;
+    uint32_t maxLogQP256;
+};
+
+const SecurityBound securityBounds[] = {
+    {1024, 27, 19, 14},     {2048, 54, 37, 29},     {4096, 109, 75, 58},
+    {8192, 218, 152, 118},  {16384, 438, 305, 237}, {32768, 881, 611, 476},
+};
+
+// Size of OpenFHE's auxiliary (P) moduli, and the largest modulus a 64-bit
+// native backend takes.
+const uint32_t auxModSize = 60;
+const uint32_t maxModSize = 60;
+
+uint32_t maxLogQP(const SecurityBound& bound, SecurityLevel securityLevel) {
+    switch (securityLevel) {
+        case HEStd_128_classic:
+            return bound.maxLogQP128;
+        case HEStd_192_classic:
+            return bound.maxLogQP192;
+        case HEStd_256_classic:
+            return bound.maxLogQP256;
+        default:
+            throw invalid_argument("chooseParameters: unsupported security level");
+    }
+}
+
+uint32_t ceilDiv(uint32_t a, uint32_t b) {
+    return (a + b - 1) / b;
+}
+
+// Hybrid key switching over `towers` limbs with `digits` digits and `aux` P
+// limbs: INTT, per-digit basis extension and NTT, key product, ModDown.
+OpCost estimateCost(uint32_t ringDim, uint32_t towers, uint32_t digits, uint32_t aux) {
+    const double n = ringDim;
+    auto ntt = [&](double limbs) { return limbs * n / 2 * log2(n); };
+    const uint32_t alpha = ceilDiv(towers, digits);
+    const double extended = towers + aux;
+
+    double keySwitch = ntt(towers);
+    keySwitch += digits * (alpha * (extended - alpha) * n + ntt(extended - alpha));
+    keySwitch += 2 * digits * extended * n;
+    keySwitch += 2 * (ntt(aux) + aux * towers * n + ntt(towers));
+
+    OpCost cost;
+    cost.add = 2 * towers * n / 1e6;
+    cost.multPlain = 2 * towers * n / 1e6;
+    cost.multRelin = (4 * towers * n + keySwitch + 2 * ntt(towers)) / 1e6;
+    cost.rotate = (keySwitch + 2 * towers * n) / 1e6;
+    return cost;
+}
+
+}  // namespace
+
+ParameterChoice chooseParameters(const ComputationPlan& plan, SecurityLevel securityLevel) {
+    if (plan.multDepth == 0 || plan.slots == 0) {
+        throw invalid_argument("chooseParameters: plan needs a depth and a slot count");
+    }
+    const double magnitudeBits = max(0.0, log2(plan.maxMagnitude));
+
+    for (const auto& bound : securityBounds) {
+        if (bound.ringDim / 2 < plan.slots) {
+            continue;
+        }
+        // Fresh encryption and rescaling leave noise around sqrt(N) times a
+        // small constant, which grows with depth and with the slot values.
+        double noiseBits = 0.5 * log2(bound.ringDim) + 5 + log2(plan.multDepth + 1) + magnitudeBits;
+        uint32_t scaleModSize = max(20u, static_cast<uint32_t>(ceil(plan.precisionBits + noiseBits)));
+        if (scaleModSize >= maxModSize) {
+            throw invalid_argument("chooseParameters: " + to_string(plan.precisionBits) +
+                                   " bits of precision need a scaling modulus above " + to_string(maxModSize) +
+                                   " bits");
+        }
+        // The last modulus holds the result plus its integer part with room for
+        // the noise. Past the largest modulus, spare levels make up the rest.
+        const uint32_t needed = scaleModSize + static_cast<uint32_t>(ceil(magnitudeBits)) + 10;
+        const uint32_t firstModSize = min(maxModSize, needed);
+        const uint32_t multDepth =
+            plan.multDepth + (needed > maxModSize ? ceilDiv(needed - maxModSize, scaleModSize) : 0);
+        const uint32_t towers = multDepth + 1;
+        uint32_t logQ = firstModSize + multDepth * scaleModSize;
+
+        // Fewer digits need a larger P; keep the cheapest key switching that fits.
+        ParameterChoice best;
+        for (uint32_t digits = 1; digits <= towers; digits++) {
+            uint32_t digitBits = firstModSize + (ceilDiv(towers, digits) - 1) * scaleModSize;
+            uint32_t aux = ceilDiv(digitBits, auxModSize);
+            uint32_t logP = aux * auxModSize;
+            if (logQ + logP > maxLogQP(bound, securityLevel)) {
+                continue;
+            }
+
+            ParameterChoice choice;
+            choice.securityLevel = securityLevel;
+            choice.ringDim = bound.ringDim;
+            choice.multDepth = multDepth;
+            choice.scaleModSize = scaleModSize;
+            choice.firstModSize = firstModSize;
+            choice.numLargeDigits = digits;
+            choice.batchSize = plan.slots;
+            choice.logQ = logQ;
+            choice.logP = logP;
+            double keyBytes = 2.0 * digits * (towers + aux) * bound.ringDim * 8;
+            choice.evalKeyMegabytes = (1 + plan.rotations.size()) * keyBytes / (1 << 20);
+            choice.cost = estimateCost(bound.ringDim, towers, digits, aux);
+            if (best.ringDim == 0 || choice.cost.multRelin < best.cost.multRelin) {
+                best = choice;
+            }
+        }
+        if (best.ringDim != 0) {
+            return best;
+        }
+    }
+    throw invalid_argument("chooseParameters: depth " + to_string(plan.multDepth) +
+                           " does not fit any supported ring dimension; enable bootstrapping");
+}
+
+CCParams<CryptoContextCKKSRNS> ParameterChoice::Parameters() const {
+    // multDepth already holds any spare levels the first modulus needs.
+    CCParams<CryptoContextCKKSRNS> parameters = ckksParameters(multDepth, scaleModSize, batchSize);
+    parameters.SetFirstModSize(firstModSize);
+    parameters.SetSecurityLevel(securityLevel);
+    parameters.SetRingDim(ringDim);
+    parameters.SetKeySwitchTechnique(HYBRID);
+    parameters.SetNumLargeDigits(numLargeDigits);
+    return parameters;
+}
+
+void ParameterChoice::Report(ostream& out) const {
+    out << "Ring dimension: " << ringDim << " | depth: " << multDepth << " | scaling/first modulus: " << scaleModSize
+        << "/" << firstModSize << " bits | key-switching digits: " << numLargeDigits << endl;
+    out << "log2 Q: " << logQ << " | log2 P: " << logP << " | eval keys: " << evalKeyMegabytes << " MB" << endl;
+    out << "Estimated cost (M mod-mults): add " << cost.add << " | plaintext mult " << cost.multPlain
+        << " | relinearized mult " << cost.multRelin << " | rotation " << cost.rotate << endl;
+}
+
+ComputationPlan planPipeline(const Pipeline& pipeline, const GridShape& shape, const Range& input, uint32_t batchSize,
+                             double precisionBits) {
+    if (pipeline.BootstrappingEnabled()) {
+        throw invalid_argument("planPipeline: bootstrapping pipelines use Pipeline::Parameters()");
+    }
+    ComputationPlan plan;
+    plan.multDepth = pipeline.Depth();
+    plan.slots = batchSize;
+    plan.rotations = pipeline.RotationIndices(batchSize, shape);
+    plan.precisionBits = precisionBits;
+    plan.maxMagnitude = max(abs(input.lo), abs(input.hi));
+    for (const Range& range : pipeline.Ranges(input)) {
+        plan.maxMagnitude = max(plan.maxMagnitude, max(abs(range.lo), abs(range.hi)));
+    }
+    return plan;
+}
+
+}  // namespace fhe
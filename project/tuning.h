@@ -0,0 +1,64 @@
+#pragma once
+
+#include "pipeline.h"
+#include <ostream>
+#include <vector>
+
+namespace fhe {
+
+// What a computation needs from its CKKS context.
+struct ComputationPlan {
+    uint32_t multDepth = 1;
+    // Slots per ciphertext; the ring dimension must be at least twice this.
+    uint32_t slots = 1;
+    std::vector<int32_t> rotations;
+    // Target absolute error 2^-precisionBits on the final result.
+    double precisionBits = 20.0;
+    // Largest |value| any intermediate slot takes.
+    double maxMagnitude = 1.0;
+};
+
+// Estimated cost of one primitive, in millions of modular multiply-adds on
+// 64-bit words. A model for comparing candidates, not a timing.
+struct OpCost {
+    double add = 0.0;
+    double multPlain = 0.0;
+    double multRelin = 0.0;
+    double rotate = 0.0;
+};
+
+// Smallest parameters found for a plan.
+struct ParameterChoice {
+    lbcrypto::SecurityLevel securityLevel = lbcrypto::HEStd_128_classic;
+    uint32_t ringDim = 0;
+    uint32_t multDepth = 0;
+    uint32_t scaleModSize = 0;
+    uint32_t firstModSize = 0;
+    uint32_t numLargeDigits = 0;
+    uint32_t batchSize = 0;
+    // Ciphertext modulus Q, key-switching modulus P.
+    uint32_t logQ = 0;
+    uint32_t logP = 0;
+    // Eval keys for relinearization plus one per rotation.
+    double evalKeyMegabytes = 0.0;
+    OpCost cost;
+
+    lbcrypto::CCParams<lbcrypto::CryptoContextCKKSRNS> Parameters() const;
+    void Report(std::ostream& out) const;
+};
+
+// Picks the smallest ring dimension that fits the plan at the given security
+// level, then the key-switching digit count with the cheapest estimated
+// relinearization among those whose extra modulus still fits. The scaling and
+// first moduli are sized for the target precision; when the result needs more
+// than the largest first modulus, the depth gains spare levels to hold it.
+// Throws if no supported ring dimension fits.
+ParameterChoice chooseParameters(const ComputationPlan& plan,
+                                 lbcrypto::SecurityLevel securityLevel = lbcrypto::HEStd_128_classic);
+
+// Plan for running `pipeline` on grids of shape `shape` with values in
+// `input`, without bootstrapping.
+ComputationPlan planPipeline(const Pipeline& pipeline, const GridShape& shape, const Range& input, uint32_t batchSize,
+                             double precisionBits);
+
+}  // namespace fhe